@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace sdf {
+
+// Output files written by a background thread. Any thread hands over a whole
+// buffer and its file offset; the writer stores it with one positional write,
+// so jobs can arrive in any order and producers never wait on the disk. Jobs
+// travel through a bounded lock-free queue, and the writer sleeps on an
+// atomic counter while it is empty.
+class AsyncWriter {
+ public:
+  class File;
+
+  explicit AsyncWriter(size_t capacity = 1024) {
+    size_t n = 1;
+    while (n < capacity) n *= 2;
+    slots_ = std::make_unique<Slot[]>(n);
+    mask_ = n - 1;
+    for (size_t i = 0; i < n; ++i) slots_[i].seq.store(i);
+    thread_ = std::thread([this] { Loop(); });
+  }
+  ~AsyncWriter() { Finish(); }
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  // Creates or truncates path. Call from the owning thread; the handle stays
+  // valid until Finish().
+  File* Open(const std::filesystem::path& path) {
+    files_.emplace_back(path);
+    if (!files_.back().Valid())
+      throw std::runtime_error("Cannot open " + path.string() +
+                               " for writing");
+    return &files_.back();
+  }
+
+  // Writes bytes at offset. The memory must stay untouched until done runs
+  // on the writer thread, once the job is over, or else until Finish().
+  void Write(File* file, uint64_t offset, std::span<const uint8_t> bytes,
+             std::function<void()> done = {}) {
+    Push({file, offset, bytes, {}, std::move(done)});
+  }
+
+  // Writes what encode(buf) leaves in buf at offset; encode runs on the
+  // writer thread, so turning pixels into a file format costs compute
+  // nothing.
+  void Write(File* file, uint64_t offset,
+             std::function<void(std::vector<uint8_t>&)> encode,
+             std::function<void()> done = {}) {
+    Push({file, offset, {}, std::move(encode), std::move(done)});
+  }
+
+  // Like the encode overload, but the bytes land right after the end of what
+  // the file holds so far. Appends to one file must be issued in order, one
+  // thread at a time.
+  void Append(File* file,
+              std::function<void(std::vector<uint8_t>&)> encode,
+              std::function<void()> done = {}) {
+    Push({file, kAppend, {}, std::move(encode), std::move(done)});
+  }
+
+  // Writes every job pushed before the call, then closes every file; false
+  // if any write failed.
+  bool Finish() {
+    if (thread_.joinable()) {
+      closing_.store(true);
+      pushed_.fetch_add(1);
+      pushed_.notify_one();
+      thread_.join();
+    }
+    files_.clear();
+    return !failed_.load();
+  }
+
+  class File {
+   public:
+    explicit File(const std::filesystem::path& path) {
+#ifdef _WIN32
+      handle_ = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+      fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    }
+    ~File() {
+#ifdef _WIN32
+      if (Valid()) CloseHandle(handle_);
+#else
+      if (Valid()) ::close(fd_);
+#endif
+    }
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+#ifdef _WIN32
+    bool Valid() const { return handle_ != INVALID_HANDLE_VALUE; }
+#else
+    bool Valid() const { return fd_ >= 0; }
+#endif
+
+    // One past the last byte written.
+    uint64_t Size() const { return size_; }
+
+    bool WriteAt(uint64_t offset, const uint8_t* p, size_t n) {
+      size_ = std::max<uint64_t>(size_, offset + n);
+      while (n > 0) {
+#ifdef _WIN32
+        OVERLAPPED at = {};
+        at.Offset = DWORD(offset);
+        at.OffsetHigh = DWORD(offset >> 32);
+        DWORD done = 0;
+        const DWORD chunk = DWORD(std::min<size_t>(n, 1u << 30));
+        if (!WriteFile(handle_, p, chunk, &done, &at) || done == 0)
+          return false;
+#else
+        const ssize_t done = ::pwrite(fd_, p, n, off_t(offset));
+        if (done <= 0) return false;
+#endif
+        offset += done;
+        p += done;
+        n -= size_t(done);
+      }
+      return true;
+    }
+
+   private:
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    uint64_t size_ = 0;
+  };
+
+ private:
+  static constexpr uint64_t kAppend = ~uint64_t(0);
+
+  struct Job {
+    File* file = nullptr;
+    uint64_t offset = 0;
+    std::span<const uint8_t> bytes;
+    std::function<void(std::vector<uint8_t>&)> encode;
+    std::function<void()> done;  // after the write, failed or not
+  };
+  // Bounded MPSC ring (Vyukov): seq == pos marks a slot free for the
+  // producer claiming pos, seq == pos + 1 a job ready for the consumer.
+  struct Slot {
+    std::atomic<size_t> seq;
+    Job job;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+  std::atomic<size_t> tail_{0};
+  size_t head_ = 0;  // writer thread only
+  std::atomic<uint64_t> pushed_{0};
+  std::atomic<bool> closing_{false};
+  std::atomic<bool> failed_{false};
+  std::list<File> files_;
+  std::thread thread_;
+
+  void Push(Job job) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const auto diff = std::ptrdiff_t(seq - pos);
+      if (diff == 0 && tail_.compare_exchange_weak(
+                           pos, pos + 1, std::memory_order_relaxed))
+        break;
+      if (diff < 0) std::this_thread::yield();  // full: the writer is behind
+      if (diff != 0) pos = tail_.load(std::memory_order_relaxed);
+    }
+    slot->job = std::move(job);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    pushed_.fetch_add(1, std::memory_order_release);
+    pushed_.notify_one();
+  }
+
+  bool Pop(Job& out) {
+    Slot& slot = slots_[head_ & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != head_ + 1) return false;
+    out = std::move(slot.job);
+    slot.job = {};
+    slot.seq.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+  void Loop() {
+    std::vector<uint8_t> buf;
+    Job job;
+    for (;;) {
+      const uint64_t seen = pushed_.load(std::memory_order_acquire);
+      if (!Pop(job)) {
+        // A Push may land between the failed Pop and Finish(): leave only
+        // once every claimed slot has been written out.
+        if (closing_.load(std::memory_order_acquire)) {
+          if (tail_.load(std::memory_order_acquire) == head_) return;
+          std::this_thread::yield();
+          continue;
+        }
+        pushed_.wait(seen);
+        continue;
+      }
+      std::span<const uint8_t> bytes = job.bytes;
+      if (job.encode) {
+        buf.clear();
+        job.encode(buf);
+        bytes = buf;
+      }
+      const uint64_t at =
+          job.offset == kAppend ? job.file->Size() : job.offset;
+      if (!job.file->WriteAt(at, bytes.data(), bytes.size()))
+        failed_.store(true);
+      if (job.done) job.done();
+    }
+  }
+};
+
+}  // namespace sdf
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+namespace sdf {
+
+// Skyline bottom-left packer for a fixed-width atlas page that grows in
+// height up to max_height. The skyline is the list of horizontal segments
+// forming the top of everything placed so far; a rectangle goes where its
+// top edge ends up lowest, ties broken by the narrower segment it rests on,
+// then by x.
+class SkylinePacker {
+ public:
+  explicit SkylinePacker(int width, int max_height = INT_MAX)
+      : width_(width), max_height_(max_height) {
+    skyline_.push_back({0, 0, width});
+  }
+
+  // Places a w x h rectangle and returns its corner in x, y. With
+  // allow_rotate the h x w orientation is tried too and rotated tells which
+  // one won. False when it fits neither way within the page.
+  bool Insert(int w, int h, bool allow_rotate, int& x, int& y,
+              bool& rotated) {
+    int best = -1, best_top = 0, best_w = 0, best_y = 0;
+    bool best_rot = false;
+    for (int turn = 0; turn < (allow_rotate && w != h ? 2 : 1); ++turn) {
+      const int rw = turn ? h : w, rh = turn ? w : h;
+      for (size_t i = 0; i < skyline_.size(); ++i) {
+        const int at = Fit(i, rw);
+        if (at < 0 || at + rh > max_height_) continue;
+        const int top = at + rh;
+        if (best < 0 || top < best_top ||
+            (top == best_top && skyline_[i].w < best_w)) {
+          best = int(i);
+          best_top = top;
+          best_w = skyline_[i].w;
+          best_y = at;
+          best_rot = turn != 0;
+        }
+      }
+    }
+    if (best < 0) return false;
+    x = skyline_[best].x;
+    y = best_y;
+    rotated = best_rot;
+    Place(size_t(best), x, best_top, rotated ? h : w);
+    height_ = std::max(height_, best_top);
+    return true;
+  }
+
+  int Height() const noexcept { return height_; }
+
+ private:
+  struct Segment {
+    int x, y, w;
+  };
+  std::vector<Segment> skyline_;
+  int width_, max_height_;
+  int height_ = 0;
+
+  // Lowest y at which a rectangle of width w fits with its left edge on
+  // segment i, or -1 if it would stick out on the right.
+  int Fit(size_t i, int w) const {
+    if (skyline_[i].x + w > width_) return -1;
+    int y = 0;
+    for (int left = w; left > 0; left -= skyline_[i++].w)
+      y = std::max(y, skyline_[i].y);
+    return y;
+  }
+
+  void Place(size_t i, int x, int top, int w) {
+    skyline_.insert(skyline_.begin() + i, {x, top, w});
+    // Trim the segments now covered by the new one.
+    for (size_t j = i + 1; j < skyline_.size();) {
+      const Segment& prev = skyline_[j - 1];
+      const int cut = prev.x + prev.w - skyline_[j].x;
+      if (cut <= 0) break;
+      skyline_[j].x += cut;
+      skyline_[j].w -= cut;
+      if (skyline_[j].w > 0) break;
+      skyline_.erase(skyline_.begin() + j);
+    }
+    for (size_t j = 0; j + 1 < skyline_.size();) {
+      if (skyline_[j].y == skyline_[j + 1].y) {
+        skyline_[j].w += skyline_[j + 1].w;
+        skyline_.erase(skyline_.begin() + j + 1);
+      } else {
+        ++j;
+      }
+    }
+  }
+};
+
+}  // namespace sdf
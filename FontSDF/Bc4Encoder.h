@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "SimdKernels.h"
+
+namespace sdf {
+
+// BC4 (one channel, 4 bpp) encoding of a single-channel atlas. Every block
+// uses the eight-value mode with its own minimum and maximum as endpoints,
+// which keeps the linear ramps of a distance field within half a step of
+// (max - min) / 7. Texels are projected onto the ramp with a 16-bit
+// reciprocal, the same in every variant, so output matches the scalar
+// reference bit for bit.
+struct Bc4Kernel {
+  const char* name;
+  // Encodes the 4 x 4 block at src, rows pitch bytes apart, into out[8].
+  void (*block)(const uint8_t* src, size_t pitch, uint8_t* out);
+};
+
+namespace kernels {
+
+// Palette order is max, min, then six steps from max towards min.
+inline uint8_t Bc4Index(int t) {
+  return uint8_t(t == 0 ? 0 : t == 7 ? 1 : t + 1);
+}
+
+// Endpoints and the 48 index bits.
+inline void Bc4Pack(int hi, int lo, const uint8_t* idx, uint8_t* out) {
+  out[0] = uint8_t(hi);
+  out[1] = uint8_t(lo);
+  uint64_t bits = 0;
+  for (int i = 15; i >= 0; --i) bits = (bits << 3) | idx[i];
+  for (int k = 0; k < 6; ++k) out[2 + k] = uint8_t(bits >> (8 * k));
+}
+
+// (x * 14 + range) * recip >> 16 is round(x * 7 / range), or one too many
+// just below a step; the callers take the step back when t * 2 * range
+// exceeds the numerator.
+inline int Bc4Recip(int range) {
+  return range ? (65536 + 2 * range - 1) / (2 * range) : 0;
+}
+
+// The block's rows gathered into 16 contiguous bytes.
+inline void Bc4Gather(const uint8_t* src, size_t pitch, uint8_t* v) {
+  for (int y = 0; y < 4; ++y) std::memcpy(v + y * 4, src + y * pitch, 4);
+}
+
+inline void Bc4BlockScalar(const uint8_t* src, size_t pitch, uint8_t* out) {
+  uint8_t v[16];
+  Bc4Gather(src, pitch, v);
+  const int hi = *std::max_element(v, v + 16);
+  const int lo = *std::min_element(v, v + 16);
+  const int range = hi - lo, recip = Bc4Recip(range);
+  uint8_t idx[16];
+  for (int i = 0; i < 16; ++i) {
+    const int num = (hi - v[i]) * 14 + range;
+    int t = num * recip >> 16;
+    if (t * 2 * range > num) --t;
+    idx[i] = Bc4Index(std::min(t, 7));
+  }
+  Bc4Pack(hi, lo, idx, out);
+}
+
+#if SDF_X86
+SDF_TARGET("sse4.1")
+inline void Bc4BlockSse41(const uint8_t* src, size_t pitch, uint8_t* out) {
+  uint8_t block[16];
+  Bc4Gather(src, pitch, block);
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+  __m128i mx = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+  __m128i mn = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+  const int hi = _mm_cvtsi128_si32(mx) & 0xFF;
+  const int lo = _mm_cvtsi128_si32(mn) & 0xFF;
+  const int range = hi - lo;
+
+  // The scalar projection in 16-bit lanes; every product fits in 15 bits.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i hi16 = _mm_set1_epi16(int16_t(hi));
+  const __m128i bias = _mm_set1_epi16(int16_t(range));
+  const __m128i range2 = _mm_set1_epi16(int16_t(2 * range));
+  const __m128i k14 = _mm_set1_epi16(14);
+  const __m128i recip = _mm_set1_epi16(int16_t(Bc4Recip(range)));
+  auto project = [&](__m128i x) {
+    const __m128i num =
+        _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(hi16, x), k14), bias);
+    const __m128i t = _mm_mulhi_epu16(num, recip);
+    // Adding the all-ones compare mask subtracts one.
+    return _mm_add_epi16(
+        t, _mm_cmpgt_epi16(_mm_mullo_epi16(t, range2), num));
+  };
+  __m128i t = _mm_packus_epi16(project(_mm_unpacklo_epi8(v, zero)),
+                               project(_mm_unpackhi_epi8(v, zero)));
+  t = _mm_min_epu8(t, _mm_set1_epi8(7));
+  // Index t + 1, except 0 for t == 0 and 1 for t == 7.
+  __m128i idx = _mm_add_epi8(t, _mm_set1_epi8(1));
+  idx = _mm_add_epi8(idx, _mm_cmpeq_epi8(t, zero));
+  idx = _mm_sub_epi8(
+      idx, _mm_and_si128(_mm_cmpeq_epi8(t, _mm_set1_epi8(7)),
+                         _mm_set1_epi8(7)));
+  alignas(16) uint8_t lanes[16];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), idx);
+  Bc4Pack(hi, lo, lanes, out);
+}
+#endif  // SDF_X86
+
+#if SDF_NEON
+inline void Bc4BlockNeon(const uint8_t* src, size_t pitch, uint8_t* out) {
+  uint8_t block[16];
+  Bc4Gather(src, pitch, block);
+  const uint8x16_t v = vld1q_u8(block);
+  const int hi = vmaxvq_u8(v), lo = vminvq_u8(v);
+  const int range = hi - lo;
+  const uint16_t recip = uint16_t(Bc4Recip(range));
+  const uint16x8_t hi16 = vdupq_n_u16(uint16_t(hi));
+  const uint16x8_t bias = vdupq_n_u16(uint16_t(range));
+  auto project = [&](uint8x8_t x) {
+    const uint16x8_t num =
+        vmlaq_n_u16(bias, vsubq_u16(hi16, vmovl_u8(x)), 14);
+    uint16x8_t t =
+        vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(num), recip), 16),
+                     vshrn_n_u32(vmull_n_u16(vget_high_u16(num), recip), 16));
+    t = vaddq_u16(t, vcgtq_u16(vmulq_n_u16(t, uint16_t(2 * range)), num));
+    return vqmovn_u16(t);
+  };
+  const uint8x16_t seven = vdupq_n_u8(7);
+  const uint8x16_t t = vminq_u8(
+      vcombine_u8(project(vget_low_u8(v)), project(vget_high_u8(v))), seven);
+  uint8x16_t idx = vaddq_u8(t, vdupq_n_u8(1));
+  idx = vaddq_u8(idx, vceqq_u8(t, vdupq_n_u8(0)));
+  idx = vsubq_u8(idx, vandq_u8(vceqq_u8(t, seven), seven));
+  uint8_t lanes[16];
+  vst1q_u8(lanes, idx);
+  Bc4Pack(hi, lo, lanes, out);
+}
+#endif  // SDF_NEON
+
+}  // namespace kernels
+
+// Every variant the running CPU supports, best first; the scalar reference
+// always comes last.
+inline std::vector<Bc4Kernel> SupportedBc4Kernels() {
+  std::vector<Bc4Kernel> out;
+#if SDF_X86
+  int r[4];
+  kernels::CpuId(1, 0, r);
+  if (r[2] & (1 << 19)) out.push_back({"SSE4.1", kernels::Bc4BlockSse41});
+#elif SDF_NEON
+  out.push_back({"NEON", kernels::Bc4BlockNeon});
+#endif
+  out.push_back({"scalar", kernels::Bc4BlockScalar});
+  return out;
+}
+
+inline Bc4Kernel DetectBc4Kernel() { return SupportedBc4Kernels().front(); }
+
+// Chosen once, on first use, like Kernels().
+inline const Bc4Kernel& Bc4() {
+  static const Bc4Kernel k = DetectBc4Kernel();
+  return k;
+}
+
+// Bytes of BC4 data for a w x h image; both must be multiples of 4.
+constexpr size_t Bc4Size(int w, int h) { return size_t(w) * h / 2; }
+
+// Encodes block rows [by0, by1) of a w-wide image (w a multiple of 4) into
+// out, which points at the first block of row by0. Blocks are stored row by
+// row, 8 bytes each.
+inline void EncodeBc4Rows(const uint8_t* image, int w, int by0, int by1,
+                          uint8_t* out) {
+  const Bc4Kernel& k = Bc4();
+  for (int by = by0; by < by1; ++by) {
+    const uint8_t* row = image + size_t(by) * 4 * w;
+    for (int bx = 0; bx < w / 4; ++bx, out += 8) k.block(row + bx * 4, w, out);
+  }
+}
+
+}  // namespace sdf
@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace sdf {
+
+// 1 bit per pixel, rows padded to whole 64-bit words. Bit x of a row lives in
+// word x >> 6 at bit x & 63, so a word covers 64 consecutive pixels and the
+// padding bits past w stay clear.
+struct BitPlane {
+  int w{}, h{}, pitch{};  // pitch in words
+  std::vector<uint64_t> data;
+  BitPlane() = default;
+  BitPlane(int width, int height) { Reset(width, height); }
+
+  // Resizes and clears, keeping the allocation when it is large enough.
+  void Reset(int width, int height) {
+    w = width;
+    h = height;
+    pitch = (w + 63) >> 6;
+    data.assign(size_t(pitch) * h, 0);
+  }
+
+  uint64_t* Row(int y) { return data.data() + size_t(y) * pitch; }
+  const uint64_t* Row(int y) const { return data.data() + size_t(y) * pitch; }
+
+  void Set(int x, int y) { Row(y)[x >> 6] |= uint64_t(1) << (x & 63); }
+  bool GetUnchecked(int x, int y) const {
+    return (Row(y)[x >> 6] >> (x & 63)) & 1;
+  }
+  bool Get(int x, int y) const {
+    if (x < 0 || y < 0 || x >= w || y >= h) return false;
+    return GetUnchecked(x, y);
+  }
+
+  // Sets [x0, x1] of row y; both ends inclusive and inside the plane.
+  void FillSpan(int y, int x0, int x1) {
+    uint64_t* row = Row(y);
+    const int w0 = x0 >> 6, w1 = x1 >> 6;
+    const uint64_t head = ~uint64_t(0) << (x0 & 63);
+    const uint64_t tail = ~uint64_t(0) >> (63 - (x1 & 63));
+    if (w0 == w1) {
+      row[w0] |= head & tail;
+      return;
+    }
+    row[w0] |= head;
+    std::fill(row + w0 + 1, row + w1, ~uint64_t(0));
+    row[w1] |= tail;
+  }
+
+  // 0 when every pixel of [x0, x1] x [y0, y1] is clear, 1 when every one is
+  // set, 2 when mixed. The rectangle must lie inside the plane.
+  int RectState(int x0, int y0, int x1, int y1) const {
+    const int w0 = x0 >> 6, w1 = x1 >> 6;
+    bool any = false, all = true;
+    for (int y = y0; y <= y1; ++y) {
+      const uint64_t* row = Row(y);
+      for (int i = w0; i <= w1; ++i) {
+        uint64_t m = ~uint64_t(0);
+        if (i == w0) m &= ~uint64_t(0) << (x0 & 63);
+        if (i == w1) m &= ~uint64_t(0) >> (63 - (x1 & 63));
+        uint64_t v = row[i] & m;
+        any |= v != 0;
+        all &= v == m;
+      }
+      if (any && !all) return 2;
+    }
+    return any ? 1 : 0;
+  }
+
+  // Nearest column >= x (FindNext) or <= x (FindPrev) in row y whose pixel
+  // equals value. Pixels outside the plane read as clear, so a clear search
+  // can answer w or -1 (or x itself when x is already outside); a set search
+  // returns w or -1 when the row has no match.
+  int FindNext(int y, int x, bool value) const {
+    if (x >= w) return value ? w : x;
+    if (x < 0) {
+      if (!value) return x;
+      x = 0;
+    }
+    const uint64_t* row = Row(y);
+    const uint64_t flip = value ? 0 : ~uint64_t(0);
+    int wi = x >> 6;
+    uint64_t word = (row[wi] ^ flip) & (~uint64_t(0) << (x & 63));
+    for (;;) {
+      if (word) return std::min(w, (wi << 6) + std::countr_zero(word));
+      if (++wi >= pitch) return w;
+      word = row[wi] ^ flip;
+    }
+  }
+  int FindPrev(int y, int x, bool value) const {
+    if (x < 0) return value ? -1 : x;
+    if (x >= w) {
+      if (!value) return x;
+      x = w - 1;
+    }
+    const uint64_t* row = Row(y);
+    const uint64_t flip = value ? 0 : ~uint64_t(0);
+    int wi = x >> 6;
+    uint64_t word = (row[wi] ^ flip) & (~uint64_t(0) >> (63 - (x & 63)));
+    for (;;) {
+      if (word) return (wi << 6) + 63 - std::countl_zero(word);
+      if (--wi < 0) return -1;
+      word = row[wi] ^ flip;
+    }
+  }
+
+  // Distance from cx to the nearest column of [x0, x1] in row y whose pixel
+  // equals value, or -1 when there is none. Pixels outside the plane read as
+  // clear; only the words under the span are read.
+  int NearestInSpan(int y, int x0, int x1, int cx, bool value) const {
+    if (y < 0 || y >= h || x1 < 0 || x0 >= w)
+      return value ? -1 : std::abs(std::clamp(cx, x0, x1) - cx);
+    int best = -1;
+    auto take = [&](int d) {
+      if (best < 0 || d < best) best = d;
+    };
+    if (!value && x0 < 0) take(std::abs(std::clamp(cx, x0, -1) - cx));
+    if (!value && x1 >= w) take(std::abs(std::clamp(cx, w, x1) - cx));
+    const int a = std::max(x0, 0), b = std::min(x1, w - 1);
+    const uint64_t* row = Row(y);
+    const uint64_t flip = value ? 0 : ~uint64_t(0);
+    // Word wi of the row limited to columns [lo, hi].
+    auto bits = [&](int wi, int lo, int hi) {
+      uint64_t m = ~uint64_t(0);
+      if (wi == lo >> 6) m &= ~uint64_t(0) << (lo & 63);
+      if (wi == hi >> 6) m &= ~uint64_t(0) >> (63 - (hi & 63));
+      return (row[wi] ^ flip) & m;
+    };
+    if (const int lo = std::max(cx, a); lo <= b)
+      for (int wi = lo >> 6; wi <= b >> 6; ++wi)
+        if (const uint64_t v = bits(wi, lo, b)) {
+          take((wi << 6) + std::countr_zero(v) - cx);
+          break;
+        }
+    if (const int hi = std::min(cx, b); a <= hi)
+      for (int wi = hi >> 6; wi >= a >> 6; --wi)
+        if (const uint64_t v = bits(wi, a, hi)) {
+          take(cx - ((wi << 6) + 63 - std::countl_zero(v)));
+          break;
+        }
+    return best;
+  }
+
+  // Horizontal distance from x to the nearest pixel equal to value in row y
+  // (rows outside the plane are all clear), or -1 when there is none.
+  int NearestInRow(int y, int x, bool value) const {
+    if (y < 0 || y >= h) return value ? -1 : 0;
+    int r = FindNext(y, x, value);
+    int l = FindPrev(y, x, value);
+    int best = -1;
+    if (r < w || !value) best = r - x;
+    if (l >= 0 || !value) best = (best < 0) ? x - l : std::min(best, x - l);
+    return best;
+  }
+};
+
+// The same pixels kept as the set runs of each row: row y owns
+// spans[row_start[y] .. row_start[y + 1]), sorted, disjoint and separated by
+// at least one clear pixel, both ends inclusive. Memory follows the outline
+// instead of the plane area, and row queries binary-search the runs.
+struct SpanPlane {
+  struct Span {
+    int x0, x1;
+  };
+  int w{}, h{};
+  std::vector<uint32_t> row_start;
+  std::vector<Span> spans;
+
+  SpanPlane() = default;
+  SpanPlane(int width, int height) { Reset(width, height); }
+
+  // Empties the plane, keeping the row table and span storage.
+  void Reset(int width, int height) {
+    w = width;
+    h = height;
+    row_start.assign(size_t(h) + 1, 0);
+    spans.clear();
+    filled_ = 0;
+  }
+
+  // Rows must be filled in increasing y; spans of one row may arrive in any
+  // order and may overlap.
+  void AddSpan(int y, int x0, int x1) {
+    for (int r = filled_ + 1; r <= y; ++r)
+      row_start[r] = uint32_t(spans.size());
+    filled_ = std::max(filled_, y);
+    const size_t first = row_start[y];
+    auto it = std::lower_bound(
+        spans.begin() + first, spans.end(), x0,
+        [](const Span& s, int x) { return s.x1 + 1 < x; });
+    auto last = it;
+    while (last != spans.end() && last->x0 <= x1 + 1) {
+      x0 = std::min(x0, last->x0);
+      x1 = std::max(x1, last->x1);
+      ++last;
+    }
+    it = spans.erase(it, last);
+    spans.insert(it, {x0, x1});
+  }
+  // Closes the row table once the last span has been added.
+  void Finish() {
+    for (int r = filled_ + 1; r <= h; ++r)
+      row_start[r] = uint32_t(spans.size());
+    filled_ = h;
+  }
+
+  const Span* RowBegin(int y) const { return spans.data() + row_start[y]; }
+  const Span* RowEnd(int y) const { return spans.data() + row_start[y + 1]; }
+
+  // First span of row y ending at or after x.
+  const Span* Find(int y, int x) const {
+    return std::lower_bound(RowBegin(y), RowEnd(y), x,
+                            [](const Span& s, int v) { return s.x1 < v; });
+  }
+
+  bool GetUnchecked(int x, int y) const {
+    const Span* s = Find(y, x);
+    return s != RowEnd(y) && s->x0 <= x;
+  }
+
+  // Same contract as BitPlane::RectState.
+  int RectState(int x0, int y0, int x1, int y1) const {
+    bool any = false, all = true;
+    for (int y = y0; y <= y1; ++y) {
+      const Span* s = Find(y, x0);
+      const bool hit = s != RowEnd(y) && s->x0 <= x1;
+      any |= hit;
+      all &= hit && s->x0 <= x0 && s->x1 >= x1;
+      if (any && !all) return 2;
+    }
+    return any ? 1 : 0;
+  }
+
+  // Horizontal distance from x to the nearest pixel equal to value in row y,
+  // or -1 when there is none; like BitPlane::NearestInRow.
+  int NearestInRow(int y, int x, bool value) const {
+    if (y < 0 || y >= h) return value ? -1 : 0;
+    const Span* s = Find(y, x);
+    const bool in = s != RowEnd(y) && s->x0 <= x;
+    if (!value) return in ? std::min(x - s->x0, s->x1 - x) + 1 : 0;
+    if (in) return 0;
+    int best = -1;
+    if (s != RowEnd(y)) best = s->x0 - x;
+    if (s != RowBegin(y)) {
+      int d = x - s[-1].x1;
+      best = best < 0 ? d : std::min(best, d);
+    }
+    return best;
+  }
+
+  // Squared distance from (cx, cy) to the nearest pixel equal to value, or
+  // best when nothing is strictly closer. Rows are taken by increasing |dy|.
+  int NearestSq(int cx, int cy, bool value, int best) const {
+    for (int k = 0;; ++k) {
+      const int dy = ((k + 1) >> 1) * ((k & 1) ? -1 : 1);
+      if (dy * dy >= best) break;
+      const int dx = NearestInRow(cy + dy, cx, value);
+      if (dx >= 0) best = std::min(best, dx * dx + dy * dy);
+    }
+    return best;
+  }
+
+ private:
+  int filled_ = 0;
+};
+
+// The same pixels stored as 8 x 8 tiles, one uint64 per tile with bit
+// (y & 7) * 8 + (x & 7). A neighbourhood search touches one word per 64
+// pixels instead of one row per dy, and a whole tile is uniform exactly when
+// its word is 0 or ~0. Pixels past w / h and tiles outside the plane read as
+// clear.
+struct TiledBitPlane {
+  int w{}, h{}, tw{}, th{};  // tw / th in tiles
+  std::vector<uint64_t> tiles;
+
+  TiledBitPlane() = default;
+  explicit TiledBitPlane(const BitPlane& bp) { Build(bp); }
+
+  // Rebuilding keeps the tile storage when it is large enough.
+  void Build(const BitPlane& bp) {
+    w = bp.w;
+    h = bp.h;
+    tw = (w + 7) >> 3;
+    th = (h + 7) >> 3;
+    tiles.assign(size_t(tw) * th, 0);
+    for (int y = 0; y < h; ++y) {
+      const uint64_t* row = bp.Row(y);
+      uint64_t* dst = tiles.data() + size_t(y >> 3) * tw;
+      const int shift = (y & 7) * 8;
+      for (int tx = 0; tx < tw; ++tx) {
+        uint64_t byte = (row[tx >> 3] >> ((tx & 7) * 8)) & 0xFF;
+        dst[tx] |= byte << shift;
+      }
+    }
+  }
+
+  uint64_t Tile(int tx, int ty) const {
+    if (tx < 0 || ty < 0 || tx >= tw || ty >= th) return 0;
+    return tiles[size_t(ty) * tw + tx];
+  }
+  bool Get(int x, int y) const {
+    if (x < 0 || y < 0 || x >= w || y >= h) return false;
+    return (tiles[size_t(y >> 3) * tw + (x >> 3)] >> ((y & 7) * 8 + (x & 7))) &
+           1;
+  }
+
+  // Squared distance from (cx, cy) to the nearest pixel equal to value, or
+  // best when nothing is strictly closer. Tiles are visited in square rings
+  // around the one holding (cx, cy) until a ring cannot beat best.
+  int NearestSq(int cx, int cy, bool value, int best) const {
+    const uint64_t flip = value ? 0 : ~uint64_t(0);
+    const int ctx = cx >> 3, cty = cy >> 3;
+    auto visit = [&](int tx, int ty) {
+      const int x0 = tx << 3, y0 = ty << 3;
+      const int ddx = std::max({x0 - cx, 0, cx - x0 - 7});
+      const int ddy = std::max({y0 - cy, 0, cy - y0 - 7});
+      if (ddx * ddx + ddy * ddy >= best) return;
+      const uint64_t m = Tile(tx, ty) ^ flip;
+      if (!m) return;
+      if (m == ~uint64_t(0)) {
+        best = ddx * ddx + ddy * ddy;
+        return;
+      }
+      for (int r = 0; r < 8; ++r) {
+        const uint32_t byte = uint32_t(m >> (r * 8)) & 0xFF;
+        if (!byte) continue;
+        const int dy = y0 + r - cy;
+        int dx;
+        if (cx < x0) {
+          dx = x0 + std::countr_zero(byte) - cx;
+        } else if (cx > x0 + 7) {
+          dx = cx - (x0 + 31 - std::countl_zero(byte));
+        } else {
+          const int b = cx - x0;
+          const uint32_t right = byte >> b;
+          const uint32_t left = byte & ((2u << b) - 1);
+          dx = INT32_MAX;
+          if (right) dx = std::countr_zero(right);
+          if (left) dx = std::min(dx, b - (31 - std::countl_zero(left)));
+        }
+        best = std::min(best, dx * dx + dy * dy);
+      }
+    };
+    visit(ctx, cty);
+    for (int k = 1;; ++k) {
+      const int lb = 8 * k - 7;
+      if (lb * lb >= best) break;
+      for (int i = -k; i <= k; ++i) {
+        visit(ctx + i, cty - k);
+        visit(ctx + i, cty + k);
+      }
+      for (int i = -k + 1; i <= k - 1; ++i) {
+        visit(ctx - k, cty + i);
+        visit(ctx + k, cty + i);
+      }
+    }
+    return best;
+  }
+};
+
+// Min/max pyramid over a BitPlane. Level 0 holds one state per 64 x 64 pixel
+// block (one word wide), each higher level merges 2 x 2 blocks of the one
+// below. A distance query walks it best-first: uniform blocks of the wrong
+// colour are skipped whole, uniform blocks of the right colour answer with
+// their rectangle distance, and only mixed level-0 blocks are scanned bit by
+// bit.
+class OccupancyPyramid {
+ public:
+  enum : uint8_t { kClear = 0, kSet = 1, kMixed = 2 };
+  static constexpr int kBlockShift = 6;
+
+  // Rebuilding keeps the level storage, so a pyramid reused across glyphs
+  // stops allocating once it has seen the largest plane.
+  void Build(const BitPlane& bp) {
+    int n = 0;
+    auto next_level = [&](int bw, int bh) -> Level& {
+      if (n == int(levels_.size())) levels_.emplace_back();
+      Level& l = levels_[n++];
+      l.bw = bw;
+      l.bh = bh;
+      l.st.resize(size_t(bw) * bh);
+      return l;
+    };
+    Level& l0 =
+        next_level((bp.w + 63) >> kBlockShift, (bp.h + 63) >> kBlockShift);
+    for (int by = 0; by < l0.bh; ++by)
+      for (int bx = 0; bx < l0.bw; ++bx) {
+        int x0 = bx << kBlockShift, y0 = by << kBlockShift;
+        int x1 = std::min(bp.w, x0 + 64) - 1, y1 = std::min(bp.h, y0 + 64) - 1;
+        l0.st[by * l0.bw + bx] = uint8_t(bp.RectState(x0, y0, x1, y1));
+      }
+    while (levels_[n - 1].bw > 1 || levels_[n - 1].bh > 1) {
+      const int cw = levels_[n - 1].bw, ch = levels_[n - 1].bh;
+      Level& p = next_level((cw + 1) >> 1, (ch + 1) >> 1);
+      const Level& c = levels_[n - 2];
+      for (int by = 0; by < p.bh; ++by)
+        for (int bx = 0; bx < p.bw; ++bx) {
+          int st = -1;
+          for (int k = 0; k < 4; ++k) {
+            int cx = 2 * bx + (k & 1), cy = 2 * by + (k >> 1);
+            if (cx >= c.bw || cy >= c.bh) continue;
+            int s = c.st[cy * c.bw + cx];
+            st = (st < 0 || st == s) ? s : kMixed;
+          }
+          p.st[by * p.bw + bx] = uint8_t(st);
+        }
+    }
+    levels_used_ = n;
+  }
+
+  int Levels() const noexcept { return levels_used_; }
+  uint8_t State(int level, int bx, int by) const {
+    const Level& l = levels_[level];
+    return l.st[by * l.bw + bx];
+  }
+
+  // Squared distance from (cx, cy) to the nearest pixel equal to value, or
+  // best when nothing is strictly closer. Pixels outside the plane read as
+  // clear, as in BitPlane::Get; (cx, cy) must lie inside the plane.
+  int NearestSq(const BitPlane& bp, int cx, int cy, bool value,
+                int best) const {
+    if (!value) {
+      int edge = std::min({cx + 1, bp.w - cx, cy + 1, bp.h - cy});
+      best = std::min(best, edge * edge);
+    }
+    Visit(bp, Levels() - 1, 0, 0, cx, cy, value, best);
+    return best;
+  }
+
+ private:
+  struct Level {
+    int bw, bh;
+    std::vector<uint8_t> st;
+  };
+  std::vector<Level> levels_;
+  int levels_used_ = 0;
+
+  static int RectDistSq(int x0, int y0, int x1, int y1, int cx, int cy) {
+    int dx = std::max({x0 - cx, 0, cx - x1});
+    int dy = std::max({y0 - cy, 0, cy - y1});
+    return dx * dx + dy * dy;
+  }
+
+  void Visit(const BitPlane& bp, int level, int bx, int by, int cx, int cy,
+             bool value, int& best) const {
+    const int shift = kBlockShift + level;
+    const int x0 = bx << shift, y0 = by << shift;
+    const int x1 = std::min(bp.w, x0 + (1 << shift)) - 1;
+    const int y1 = std::min(bp.h, y0 + (1 << shift)) - 1;
+    const int lb = RectDistSq(x0, y0, x1, y1, cx, cy);
+    if (lb >= best) return;
+    const uint8_t st = State(level, bx, by);
+    if (st == (value ? kClear : kSet)) return;
+    if (st != kMixed) {
+      best = lb;
+      return;
+    }
+    if (level == 0) {
+      ScanBlock(bp, bx, y0, y1, cx, cy, value, best);
+      return;
+    }
+    const Level& c = levels_[level - 1];
+    const int cs = shift - 1;
+    std::pair<int, int> kids[4];
+    int n = 0;
+    for (int k = 0; k < 4; ++k) {
+      int kx = 2 * bx + (k & 1), ky = 2 * by + (k >> 1);
+      if (kx >= c.bw || ky >= c.bh) continue;
+      int kx0 = kx << cs, ky0 = ky << cs;
+      int d = RectDistSq(kx0, ky0, std::min(bp.w, kx0 + (1 << cs)) - 1,
+                         std::min(bp.h, ky0 + (1 << cs)) - 1, cx, cy);
+      // Insertion keeps the at most four children nearest first.
+      int i = n++;
+      for (; i > 0 && kids[i - 1] > std::pair{d, k}; --i) kids[i] = kids[i - 1];
+      kids[i] = {d, k};
+    }
+    for (int i = 0; i < n; ++i)
+      Visit(bp, level - 1, 2 * bx + (kids[i].second & 1),
+            2 * by + (kids[i].second >> 1), cx, cy, value, best);
+  }
+
+  // Rows of a mixed level-0 block, walking away from cy in both directions
+  // until the row distance alone reaches best.
+  void ScanBlock(const BitPlane& bp, int bx, int y0, int y1, int cx, int cy,
+                 bool value, int& best) const {
+    const int x0 = bx << kBlockShift;
+    const uint64_t flip = value ? 0 : ~uint64_t(0);
+    const uint64_t valid =
+        (bp.w - x0 >= 64) ? ~uint64_t(0) : (uint64_t(1) << (bp.w - x0)) - 1;
+    auto probe = [&](int y) {
+      const int dy2 = (y - cy) * (y - cy);
+      if (dy2 >= best) return false;
+      uint64_t word = (bp.Row(y)[bx] ^ flip) & valid;
+      if (!word) return true;
+      int dx;
+      if (cx < x0) {
+        dx = x0 + std::countr_zero(word) - cx;
+      } else if (cx >= x0 + 64) {
+        dx = cx - (x0 + 63 - std::countl_zero(word));
+      } else {
+        const int b = cx - x0;
+        uint64_t right = word & (~uint64_t(0) << b);
+        uint64_t left = word & (~uint64_t(0) >> (63 - b));
+        dx = INT32_MAX;
+        if (right) dx = std::countr_zero(right) - b;
+        if (left) dx = std::min(dx, b - (63 - std::countl_zero(left)));
+      }
+      best = std::min(best, dx * dx + dy2);
+      return true;
+    };
+    const int start = std::clamp(cy, y0, y1);
+    for (int y = start; y <= y1 && probe(y); ++y) {
+    }
+    for (int y = start - 1; y >= y0 && probe(y); --y) {
+    }
+  }
+};
+
+}  // namespace sdf
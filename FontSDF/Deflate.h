@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace sdf {
+
+// Streaming zlib (RFC 1950/1951) compressor. LZ77 over a 32 KiB window with
+// hash chains, then one dynamic Huffman block per kBlockSymbols symbols, so
+// memory stays fixed whatever the input size. Compressed bytes are appended
+// to the caller's vector as blocks complete.
+class DeflateEncoder {
+ public:
+  DeflateEncoder() : head_(kHashSize, -1), prev_(kWindow, -1) {}
+
+  // Compresses n more bytes; output may lag behind until Finish().
+  void Add(const uint8_t* p, size_t n, std::vector<uint8_t>& out) {
+    if (!started_) {
+      out.push_back(0x78);  // deflate, 32 KiB window
+      out.push_back(0x9C);  // default level, header check
+      started_ = true;
+    }
+    // Adler-32, reduced once per 5552 bytes, the most that cannot overflow.
+    for (size_t i = 0; i < n;) {
+      const size_t stop = std::min(n, i + 5552);
+      for (; i < stop; ++i) adler_b_ += adler_a_ += p[i];
+      adler_a_ %= 65521;
+      adler_b_ %= 65521;
+    }
+    while (n > 0) {
+      if (data_.size() >= 2 * kWindow) Slide();
+      const size_t take = std::min(n, 2 * kWindow - data_.size());
+      data_.insert(data_.end(), p, p + take);
+      p += take;
+      n -= take;
+      Match(false, out);
+    }
+  }
+
+  // Compresses what is left, ends the stream and appends the checksum.
+  void Finish(std::vector<uint8_t>& out) {
+    if (!started_) Add(nullptr, 0, out);
+    Match(true, out);
+    EmitBlock(true, out);
+    bits_.Flush(out);
+    const uint32_t adler = (adler_b_ << 16) | adler_a_;
+    for (int s = 24; s >= 0; s -= 8) out.push_back(uint8_t(adler >> s));
+  }
+
+ private:
+  static constexpr int kWindow = 32768;
+  static constexpr int kHashSize = 1 << 15;
+  static constexpr int kMinMatch = 3, kMaxMatch = 258;
+  static constexpr int kMaxChain = 48;
+  static constexpr size_t kBlockSymbols = 1 << 15;
+
+  // LSB-first bit packer.
+  struct BitWriter {
+    uint64_t acc = 0;
+    int n = 0;
+    void Put(uint32_t code, int len, std::vector<uint8_t>& out) {
+      acc |= uint64_t(code) << n;
+      n += len;
+      while (n >= 8) {
+        out.push_back(uint8_t(acc));
+        acc >>= 8;
+        n -= 8;
+      }
+    }
+    void Flush(std::vector<uint8_t>& out) {
+      if (n > 0) out.push_back(uint8_t(acc));
+      acc = 0;
+      n = 0;
+    }
+  };
+
+  // A literal (dist 0) or a match of len bytes dist back.
+  struct Symbol {
+    uint16_t lit_or_len;
+    uint16_t dist;
+  };
+
+  std::vector<uint8_t> data_;  // window history followed by new input
+  size_t pos_ = 0;             // next byte of data_ to encode
+  size_t base_ = 0;            // stream position of data_[0]
+  std::vector<int64_t> head_, prev_;
+  std::vector<Symbol> syms_;
+  BitWriter bits_;
+  uint32_t adler_a_ = 1, adler_b_ = 0;
+  bool started_ = false;
+
+  // Drops everything older than the window, keeping positions absolute.
+  void Slide() {
+    const size_t drop = pos_ - kWindow;
+    data_.erase(data_.begin(), data_.begin() + drop);
+    pos_ -= drop;
+    base_ += drop;
+  }
+
+  static uint32_t Hash(const uint8_t* p) {
+    return ((uint32_t(p[0]) << 10) ^ (uint32_t(p[1]) << 5) ^ p[2]) &
+           (kHashSize - 1);
+  }
+
+  void Insert(size_t i) {
+    const int64_t at = int64_t(base_ + i);
+    const uint32_t h = Hash(&data_[i]);
+    prev_[at & (kWindow - 1)] = head_[h];
+    head_[h] = at;
+  }
+
+  // Greedy parse while a full match can be seen ahead, or to the end when
+  // last is set.
+  void Match(bool last, std::vector<uint8_t>& out) {
+    const size_t end = data_.size();
+    while (pos_ < end && (last || end - pos_ >= size_t(kMaxMatch))) {
+      int best_len = 0, best_dist = 0;
+      if (end - pos_ >= size_t(kMinMatch)) {
+        const int max_len = int(std::min<size_t>(kMaxMatch, end - pos_));
+        const int64_t here = int64_t(base_ + pos_);
+        int64_t cand = head_[Hash(&data_[pos_])];
+        for (int chain = kMaxChain; cand >= 0 && chain > 0; --chain) {
+          const int64_t dist = here - cand;
+          if (dist > kWindow - 1 || dist <= 0) break;
+          const uint8_t* a = &data_[pos_];
+          const uint8_t* b = a - dist;
+          if (b[best_len] == a[best_len]) {
+            int len = 0;
+            while (len < max_len && a[len] == b[len]) ++len;
+            if (len > best_len) {
+              best_len = len;
+              best_dist = int(dist);
+              if (len == max_len) break;
+            }
+          }
+          cand = prev_[cand & (kWindow - 1)];
+        }
+      }
+      if (best_len >= kMinMatch) {
+        syms_.push_back({uint16_t(best_len), uint16_t(best_dist)});
+        for (int k = 0; k < best_len; ++k, ++pos_)
+          if (end - pos_ >= size_t(kMinMatch)) Insert(pos_);
+      } else {
+        syms_.push_back({data_[pos_], 0});
+        if (end - pos_ >= size_t(kMinMatch)) Insert(pos_);
+        ++pos_;
+      }
+      if (syms_.size() >= kBlockSymbols) EmitBlock(false, out);
+    }
+  }
+
+  static int LengthCode(int len, int& extra, int& extra_bits) {
+    static const uint16_t base[29] = {3,  4,  5,  6,   7,   8,   9,   10,
+                                      11, 13, 15, 17,  19,  23,  27,  31,
+                                      35, 43, 51, 59,  67,  83,  99,  115,
+                                      131, 163, 195, 227, 258};
+    int c = 28;
+    while (base[c] > len) --c;
+    extra = len - base[c];
+    extra_bits = (c < 8 || c == 28) ? 0 : (c - 4) / 4;
+    return 257 + c;
+  }
+
+  static int DistCode(int dist, int& extra, int& extra_bits) {
+    int c = 0, base = 1;
+    for (; c < 29; ++c) {
+      const int eb = c < 2 ? 0 : c / 2 - 1;
+      if (dist < base + (1 << eb)) {
+        extra = dist - base;
+        extra_bits = eb;
+        return c;
+      }
+      base += 1 << eb;
+    }
+    extra_bits = 13;
+    extra = dist - base;
+    return 29;
+  }
+
+  // Huffman code lengths for freq, none longer than max_bits; unused
+  // symbols get 0. At least two symbols are given a length, so the code is
+  // always complete.
+  static void BuildLengths(const std::vector<uint32_t>& freq, int max_bits,
+                           std::vector<uint8_t>& len) {
+    const int n = int(freq.size());
+    len.assign(n, 0);
+    std::vector<int> used;
+    for (int i = 0; i < n; ++i)
+      if (freq[i]) used.push_back(i);
+    for (int i = 0; used.size() < 2; ++i)
+      if (!freq[i]) used.push_back(i);
+    std::sort(used.begin(), used.end(), [&](int a, int b) {
+      return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+    });
+
+    // Plain Huffman depths of the sorted leaves.
+    const int m = int(used.size());
+    std::vector<int> parent(2 * m - 1, -1);
+    using Item = std::pair<uint64_t, int>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+    for (int i = 0; i < m; ++i) heap.push({freq[used[i]], i});
+    for (int next = m; heap.size() > 1; ++next) {
+      const Item a = heap.top();
+      heap.pop();
+      const Item b = heap.top();
+      heap.pop();
+      parent[a.second] = parent[b.second] = next;
+      heap.push({a.first + b.first, next});
+    }
+    std::vector<int> depth(2 * m - 1, 0);
+    for (int i = 2 * m - 3; i >= 0; --i) depth[i] = depth[parent[i]] + 1;
+
+    // Clamp to max_bits, then lengthen the shallowest codes until the
+    // lengths satisfy Kraft again.
+    std::vector<int> count(max_bits + 1, 0);
+    for (int i = 0; i < m; ++i) ++count[std::min(depth[i], max_bits)];
+    uint32_t kraft = 0;
+    for (int b = 1; b <= max_bits; ++b) kraft += count[b] << (max_bits - b);
+    while (kraft > (1u << max_bits)) {
+      --count[max_bits];
+      for (int b = max_bits - 1; b > 0; --b)
+        if (count[b]) {
+          --count[b];
+          count[b + 1] += 2;
+          break;
+        }
+      --kraft;
+    }
+    // Rarest symbols take the longest codes.
+    int i = 0;
+    for (int b = max_bits; b > 0; --b)
+      for (int k = 0; k < count[b]; ++k) len[used[i++]] = uint8_t(b);
+  }
+
+  // Canonical codes, bit-reversed for LSB-first output.
+  static void BuildCodes(const std::vector<uint8_t>& len,
+                         std::vector<uint16_t>& code) {
+    int count[16] = {}, next[16] = {};
+    for (uint8_t l : len) ++count[l];
+    count[0] = 0;
+    for (int b = 1, c = 0; b < 16; ++b) next[b] = c = (c + count[b - 1]) << 1;
+    code.assign(len.size(), 0);
+    for (size_t s = 0; s < len.size(); ++s) {
+      const int l = len[s];
+      if (!l) continue;
+      uint32_t c = next[l]++, r = 0;
+      for (int k = 0; k < l; ++k, c >>= 1) r = (r << 1) | (c & 1);
+      code[s] = uint16_t(r);
+    }
+  }
+
+  void EmitBlock(bool final, std::vector<uint8_t>& out) {
+    if (!final && syms_.empty()) return;
+    std::vector<uint32_t> lit_freq(286, 0), dist_freq(30, 0);
+    int extra, extra_bits;
+    for (const Symbol& s : syms_) {
+      if (!s.dist) {
+        ++lit_freq[s.lit_or_len];
+        continue;
+      }
+      ++lit_freq[LengthCode(s.lit_or_len, extra, extra_bits)];
+      ++dist_freq[DistCode(s.dist, extra, extra_bits)];
+    }
+    ++lit_freq[256];
+    std::vector<uint8_t> lit_len, dist_len;
+    BuildLengths(lit_freq, 15, lit_len);
+    BuildLengths(dist_freq, 15, dist_len);
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && !lit_len[hlit - 1]) --hlit;
+    while (hdist > 1 && !dist_len[hdist - 1]) --hdist;
+
+    // Run-length code the two length tables as one sequence.
+    std::vector<uint8_t> all(lit_len.begin(), lit_len.begin() + hlit);
+    all.insert(all.end(), dist_len.begin(), dist_len.begin() + hdist);
+    std::vector<std::pair<uint8_t, uint8_t>> rle;  // symbol, extra value
+    for (size_t i = 0; i < all.size();) {
+      size_t run = 1;
+      while (i + run < all.size() && all[i + run] == all[i]) ++run;
+      if (all[i] == 0 && run >= 3) {
+        run = std::min<size_t>(run, 138);
+        rle.push_back(run >= 11 ? std::pair<uint8_t, uint8_t>(18, run - 11)
+                                : std::pair<uint8_t, uint8_t>(17, run - 3));
+      } else if (all[i] != 0 && run >= 4) {
+        rle.push_back({all[i], 0});
+        run = std::min<size_t>(run - 1, 6);
+        rle.push_back({16, uint8_t(run - 3)});
+        ++run;
+      } else {
+        run = 1;
+        rle.push_back({all[i], 0});
+      }
+      i += run;
+    }
+    std::vector<uint32_t> cl_freq(19, 0);
+    for (auto& [sym, v] : rle) ++cl_freq[sym];
+    std::vector<uint8_t> cl_len;
+    std::vector<uint16_t> cl_code, lit_code, dist_code;
+    BuildLengths(cl_freq, 7, cl_len);
+    BuildCodes(cl_len, cl_code);
+    BuildCodes(lit_len, lit_code);
+    BuildCodes(dist_len, dist_code);
+    static const uint8_t kOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                       11, 4,  12, 3, 13, 2, 14, 1, 15};
+    int hclen = 19;
+    while (hclen > 4 && !cl_len[kOrder[hclen - 1]]) --hclen;
+
+    bits_.Put(final ? 1 : 0, 1, out);
+    bits_.Put(2, 2, out);  // dynamic Huffman
+    bits_.Put(hlit - 257, 5, out);
+    bits_.Put(hdist - 1, 5, out);
+    bits_.Put(hclen - 4, 4, out);
+    for (int i = 0; i < hclen; ++i) bits_.Put(cl_len[kOrder[i]], 3, out);
+    for (auto& [sym, v] : rle) {
+      bits_.Put(cl_code[sym], cl_len[sym], out);
+      if (sym == 16) bits_.Put(v, 2, out);
+      if (sym == 17) bits_.Put(v, 3, out);
+      if (sym == 18) bits_.Put(v, 7, out);
+    }
+    for (const Symbol& s : syms_) {
+      if (!s.dist) {
+        bits_.Put(lit_code[s.lit_or_len], lit_len[s.lit_or_len], out);
+        continue;
+      }
+      const int lc = LengthCode(s.lit_or_len, extra, extra_bits);
+      bits_.Put(lit_code[lc], lit_len[lc], out);
+      bits_.Put(extra, extra_bits, out);
+      const int dc = DistCode(s.dist, extra, extra_bits);
+      bits_.Put(dist_code[dc], dist_len[dc], out);
+      bits_.Put(extra, extra_bits, out);
+    }
+    bits_.Put(lit_code[256], lit_len[256], out);
+    syms_.clear();
+  }
+};
+
+}  // namespace sdf
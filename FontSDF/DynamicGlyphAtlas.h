@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FontLoader.h"
+#include "SdfGenerator.h"
+#include "TaskPool.h"
+
+namespace sdf {
+
+// AtlasGlyph::flags.
+enum AtlasGlyphFlags : uint8_t {
+  // The glyph breaks the font's bounding box and cannot fit a cell. It comes
+  // back with its advance but without texels; draw it some other way.
+  kAtlasGlyphTooLarge = 1,
+};
+
+// Where a resident glyph sits. u, v, w, h and the bearings describe the
+// glyph without its border, like GlyphRecord in the baked asset.
+struct AtlasGlyph {
+  uint16_t u = 0, v = 0, w = 0, h = 0;
+  int16_t bearing_x = 0, bearing_y = 0;
+  uint16_t advance = 0;
+  uint8_t page = 0;
+  uint8_t flags = 0;
+};
+
+// Texels of one page rewritten since the last ClearDirty(); always a whole
+// cell.
+struct DirtyRect {
+  int page;
+  int x, y, w, h;
+};
+
+// Atlas filled at run time, for text no baked charset covers. Pages are split
+// into equal cells sized from the font's bounding box, so any glyph fits any
+// cell. Once every cell is taken the least recently used one is reused, but
+// never a cell drawn in the current frame.
+//
+// Per frame: BeginFrame(), Find() for each code point drawn, Update() with the
+// frame's budget, then upload Dirty() and ClearDirty(). Find() queues a glyph
+// that is not resident and returns nullptr. Update() hands queued glyphs to
+// pool and only copies in the tiles the pool has finished, so new text shows
+// up over the next frames and the calling thread never waits on a glyph.
+// Not thread-safe: every call comes from one thread.
+class DynamicGlyphAtlas {
+ public:
+  DynamicGlyphAtlas(const ttf::FontLoader& font, const SdfConfig& cfg,
+                    int page_w, int page_h, int pages, TaskPool& pool)
+      : font_(font),
+        cfg_(cfg),
+        pool_(pool),
+        page_w_(page_w),
+        page_h_(page_h),
+        em_scale_(cfg.glyph_px / font.UnitsPerEm()) {
+    if (cfg_.supersample == 0) cfg_.supersample = AutoSupersample(cfg_);
+    cell_ = BoxOf(font.FontBounds(), em_scale_, cfg.border_px);
+    cols_ = cell_.w > 0 ? page_w / cell_.w : 0;
+    rows_ = cell_.h > 0 ? page_h / cell_.h : 0;
+    if (cols_ == 0 || rows_ == 0 || pages <= 0 || pages > 256)
+      throw std::invalid_argument("atlas page smaller than one glyph cell");
+    if (int64_t(std::max(cell_.w, cell_.h)) * cfg_.supersample > kMaxHiSide)
+      throw std::invalid_argument("supersample too large for the glyph cell");
+    pixels_.assign(pages, std::vector<uint8_t>(
+                              size_t(page_w) * page_h * cfg_.Channels(), 0));
+    cells_.resize(size_t(cols_) * rows_ * pages);
+    for (int c = int(cells_.size()) - 1; c >= 0; --c) free_.push_back(c);
+  }
+  ~DynamicGlyphAtlas() { Flush(); }
+
+  // Starts a frame; cells found from here on are kept until the next one.
+  void BeginFrame() { ++frame_; }
+
+  // The glyph of cp, or nullptr while it is still queued. Glyphs without an
+  // outline come back with w = h = 0, and so do ones too large for a cell,
+  // flagged kAtlasGlyphTooLarge. The pointer stays valid until the next
+  // Update().
+  const AtlasGlyph* Find(char32_t cp) {
+    const uint16_t gid = font_.GlyphId(cp);
+    auto [it, fresh] = slots_.try_emplace(gid);
+    Slot& s = it->second;
+    if (fresh) queue_.push_back(gid);
+    if (!s.ready) return nullptr;
+    if (s.cell >= 0) Touch(s.cell);
+    return &s.glyph;
+  }
+
+  // Copies in glyphs the pool has finished while the budget lasts, then
+  // hands queued glyphs to the pool, each with a cell of its own, until
+  // twice as many as it has threads are in flight. Returns the number of
+  // glyphs copied in.
+  int Update(std::chrono::microseconds budget) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    int published = 0;
+    while (Clock::now() - start < budget) {
+      Job job;
+      {
+        std::lock_guard<std::mutex> lock(done_mutex_);
+        if (done_.empty()) break;
+        job = std::move(done_.front());
+        done_.pop_front();
+        --in_flight_;
+      }
+      Publish(job);
+      spare_.push_back(std::move(job.texels));
+      ++published;
+    }
+    const int max_in_flight = 2 * int(pool_.Size());
+    while (!queue_.empty() && in_flight_ < max_in_flight) {
+      const uint16_t gid = queue_.front();
+      Slot& s = slots_[gid];
+      s.glyph.advance =
+          uint16_t(std::lround(font_.AdvanceWidth(gid) * em_scale_));
+      ttf::GlyphBounds b;
+      const GlyphBox box = gid && font_.Bounds(gid, b)
+                               ? BoxOf(b, em_scale_, cfg_.border_px)
+                               : GlyphBox{};
+      // Empty glyphs, and any that break the font's own bounding box, take
+      // no cell.
+      if (box.w <= 0 || box.w > cell_.w || box.h > cell_.h) {
+        if (box.w > 0) s.glyph.flags = kAtlasGlyphTooLarge;
+        s.ready = true;
+        queue_.pop_front();
+        continue;
+      }
+      const int cell = TakeCell();
+      if (cell < 0) break;  // every cell is drawn this frame
+      queue_.pop_front();
+      Job job{gid, box, cell, {}};
+      if (!spare_.empty()) {
+        job.texels = std::move(spare_.back());
+        spare_.pop_back();
+      }
+      ++in_flight_;
+      pool_.Submit([this, job = std::move(job)]() mutable { Build(job); });
+    }
+    return published;
+  }
+
+  // Blocks until every glyph handed to the pool is built; the next Update()
+  // copies them in, budget permitting. For loading screens and shutdown.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    done_cv_.wait(lock, [&] { return int(done_.size()) == in_flight_; });
+  }
+
+  const std::vector<DirtyRect>& Dirty() const noexcept { return dirty_; }
+  void ClearDirty() { dirty_.clear(); }
+
+  // page_w x page_h texels of Channels() bytes, rows packed.
+  const uint8_t* Pixels(int page) const { return pixels_[page].data(); }
+  int PageCount() const noexcept { return int(pixels_.size()); }
+  int PageWidth() const noexcept { return page_w_; }
+  int PageHeight() const noexcept { return page_h_; }
+  int Channels() const noexcept { return cfg_.Channels(); }
+  size_t Queued() const noexcept { return queue_.size(); }
+  // Glyphs handed to the pool and not yet copied in.
+  int Building() const noexcept { return in_flight_; }
+
+ private:
+  struct Slot {
+    AtlasGlyph glyph;
+    int cell = -1;  // -1 while queued or when the glyph has no texels
+    bool ready = false;
+  };
+  // A glyph on its way through the pool; its cell is off the LRU list until
+  // the tile is copied in.
+  struct Job {
+    uint16_t gid = 0;
+    GlyphBox box{};
+    int cell = -1;
+    std::vector<uint8_t> texels;
+  };
+  // Cells form an intrusive list from most to least recently drawn.
+  struct Cell {
+    uint16_t gid = 0;
+    uint64_t frame = 0;  // last frame the glyph was found in
+    int prev = -1, next = -1;
+  };
+
+  const ttf::FontLoader& font_;
+  SdfConfig cfg_;
+  TaskPool& pool_;
+  int page_w_, page_h_;
+  float em_scale_;
+  GlyphBox cell_;
+  int cols_, rows_;
+  std::vector<std::vector<uint8_t>> pixels_;
+  std::vector<Cell> cells_;
+  std::vector<int> free_;
+  int head_ = -1, tail_ = -1;
+  std::unordered_map<uint16_t, Slot> slots_;
+  std::deque<uint16_t> queue_;
+  std::vector<DirtyRect> dirty_;
+  uint64_t frame_ = 1;
+  std::vector<std::vector<uint8_t>> spare_;  // tile buffers to reuse
+  int in_flight_ = 0;
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  std::deque<Job> done_;
+
+  void Unlink(int c) {
+    Cell& e = cells_[c];
+    (e.prev >= 0 ? cells_[e.prev].next : head_) = e.next;
+    (e.next >= 0 ? cells_[e.next].prev : tail_) = e.prev;
+    e.prev = e.next = -1;
+  }
+
+  void Touch(int c) {
+    cells_[c].frame = frame_;
+    if (head_ == c) return;
+    if (cells_[c].prev >= 0) Unlink(c);
+    cells_[c].next = head_;
+    if (head_ >= 0) cells_[head_].prev = c;
+    head_ = c;
+    if (tail_ < 0) tail_ = c;
+  }
+
+  // A free cell, else the least recently drawn one with its glyph evicted;
+  // -1 when that one was drawn this frame too.
+  int TakeCell() {
+    if (!free_.empty()) {
+      const int c = free_.back();
+      free_.pop_back();
+      return c;
+    }
+    const int c = tail_;
+    if (c < 0 || cells_[c].frame == frame_) return -1;
+    slots_.erase(cells_[c].gid);
+    Unlink(c);
+    return c;
+  }
+
+  // Runs on the pool; touches nothing but the job until it is queued back.
+  void Build(Job& job) {
+    GlyphScratch& gs = ThreadGlyphScratch();
+    font_.Extract(job.gid, OutlineFlatness(font_, cfg_), gs.outline,
+                  gs.parse);
+    job.texels.resize(size_t(job.box.w) * job.box.h * cfg_.Channels());
+    GenerateSdf(gs.outline, job.box, cfg_, pool_, gs, job.texels);
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    done_.push_back(std::move(job));
+    done_cv_.notify_all();
+  }
+
+  void Publish(const Job& job) {
+    const int channels = cfg_.Channels();
+    const GlyphBox& box = job.box;
+    const int cell = job.cell;
+    const int per_page = cols_ * rows_;
+    const int page = cell / per_page, i = cell % per_page;
+    const int x = i % cols_ * cell_.w, y = i / cols_ * cell_.h;
+    const size_t pitch = size_t(page_w_) * channels;
+    const size_t row = size_t(box.w) * channels;
+    uint8_t* dst = &pixels_[page][y * pitch + size_t(x) * channels];
+    // The whole cell, so nothing of an evicted larger glyph is left for
+    // filtering to pick up around this one.
+    for (int r = 0; r < cell_.h; ++r)
+      std::memset(dst + r * pitch, EncodeNorm(-1.0f),
+                  size_t(cell_.w) * channels);
+    for (int r = 0; r < box.h; ++r)
+      std::memcpy(dst + r * pitch, &job.texels[r * row], row);
+    dirty_.push_back({page, x, y, cell_.w, cell_.h});
+
+    const int border = cfg_.border_px;
+    Slot& s = slots_[job.gid];
+    AtlasGlyph& g = s.glyph;
+    g.u = uint16_t(x + border);
+    g.v = uint16_t(y + border);
+    g.w = uint16_t(box.w - 2 * border);
+    g.h = uint16_t(box.h - 2 * border);
+    g.bearing_x = int16_t(box.left + border);
+    g.bearing_y = int16_t(box.top - border);
+    g.page = uint8_t(page);
+    s.cell = cell;
+    s.ready = true;
+    cells_[cell].gid = job.gid;
+    Touch(cell);
+  }
+};
+
+}  // namespace sdf
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
@@ -26,6 +28,21 @@ struct GlyphContour {
   int16_t advance_width = 0;
 };
 
+// Decoding buffers for Extract. Keeping one per thread and passing it back in
+// lets steady-state extraction run without heap allocations.
+struct ParseScratch {
+  std::vector<uint16_t> end_pts;
+  std::vector<uint8_t> flags;
+  std::vector<int16_t> xs, ys;
+};
+
+// What the glyf header says about a glyph, without decoding its outline.
+struct GlyphBounds {
+  int16_t x_min = 0, y_min = 0, x_max = 0, y_max = 0;
+  uint32_t points = 0;    // outline points, summed over composite parts
+  uint16_t contours = 0;  // likewise
+};
+
 class FontLoader {
  public:
   explicit FontLoader(std::span<const uint8_t> blob)
@@ -77,10 +94,42 @@ class FontLoader {
     return static_cast<float>(units_per_em_);
   }
   uint16_t GlyphCount() const noexcept { return num_glyphs_; }
+  // hhea line metrics in font units; the descender is negative.
+  int16_t Ascender() const noexcept { return ascender_; }
+  int16_t Descender() const noexcept { return descender_; }
+  int16_t LineGap() const noexcept { return line_gap_; }
+  // head bounding box, the union of every glyph's; points stays 0.
+  const GlyphBounds& FontBounds() const noexcept { return font_bounds_; }
+  uint16_t AdvanceWidth(uint16_t gid) const noexcept {
+    return (gid < advance_widths_.size()) ? advance_widths_[gid] : 0;
+  }
 
   GlyphContour Extract(uint16_t glyph_id, float flatness = 1.0f) const {
-    GlyphReader gr(*this, glyph_id, flatness);
-    return gr.Run();
+    GlyphContour out;
+    ParseScratch scratch;
+    Extract(glyph_id, flatness, out, scratch);
+    return out;
+  }
+  // Same, reusing the storage of out and scratch.
+  void Extract(uint16_t glyph_id, float flatness, GlyphContour& out,
+               ParseScratch& scratch) const {
+    GlyphReader gr(*this, glyph_id, flatness, scratch);
+    gr.Run(out);
+  }
+
+  // Bounding box and outline size of a glyph; false for an empty glyph.
+  // Cheap enough to call for every glyph up front, e.g. to order work.
+  bool Bounds(uint16_t glyph_id, GlyphBounds& out) const {
+    const uint8_t* g;
+    uint32_t len;
+    if (!GlyphOffset(glyph_id, g, len) || len < 10) return false;
+    out = {};
+    out.x_min = ReadS16(g + 2);
+    out.y_min = ReadS16(g + 4);
+    out.x_max = ReadS16(g + 6);
+    out.y_max = ReadS16(g + 8);
+    CountPoints(glyph_id, out, 0);
+    return true;
   }
 
  private:
@@ -118,6 +167,8 @@ class FontLoader {
   uint16_t num_glyphs_ = 0;
   uint16_t index_to_loc_format_ = 0;
   uint16_t num_long_hor_metrics_ = 0;
+  int16_t ascender_ = 0, descender_ = 0, line_gap_ = 0;
+  GlyphBounds font_bounds_;
 
   const uint8_t* loca_ = nullptr;
   const uint8_t* glyf_ = nullptr;
@@ -127,6 +178,10 @@ class FontLoader {
     if (auto head = TablePtr(Tag4('h', 'e', 'a', 'd')); head) {
       units_per_em_ = ReadU16(head + 18);
       index_to_loc_format_ = ReadU16(head + 50);
+      font_bounds_.x_min = ReadS16(head + 36);
+      font_bounds_.y_min = ReadS16(head + 38);
+      font_bounds_.x_max = ReadS16(head + 40);
+      font_bounds_.y_max = ReadS16(head + 42);
     }
     if (auto maxp = TablePtr(Tag4('m', 'a', 'x', 'p')); maxp)
       num_glyphs_ = ReadU16(maxp + 4);
@@ -134,8 +189,12 @@ class FontLoader {
     loca_ = TablePtr(Tag4('l', 'o', 'c', 'a'));
     glyf_ = TablePtr(Tag4('g', 'l', 'y', 'f'));
 
-    if (auto hhea = TablePtr(Tag4('h', 'h', 'e', 'a')); hhea)
+    if (auto hhea = TablePtr(Tag4('h', 'h', 'e', 'a')); hhea) {
+      ascender_ = ReadS16(hhea + 4);
+      descender_ = ReadS16(hhea + 6);
+      line_gap_ = ReadS16(hhea + 8);
       num_long_hor_metrics_ = ReadU16(hhea + 34);
+    }
     hmtx_ = TablePtr(Tag4('h', 'm', 't', 'x'));
   }
 
@@ -214,25 +273,23 @@ class FontLoader {
     }
   }
 
-  uint16_t AdvanceWidth(uint16_t gid) const noexcept {
-    return (gid < advance_widths_.size()) ? advance_widths_[gid] : 0;
-  }
-
   class GlyphReader {
    public:
-    GlyphReader(const FontLoader& f, uint16_t gid, float flat)
-        : font_(f), glyph_id_(gid), flatness_(flat) {}
-    GlyphContour Run() {
-      GlyphContour out;
+    GlyphReader(const FontLoader& f, uint16_t gid, float flat,
+                ParseScratch& scratch)
+        : font_(f), glyph_id_(gid), flatness_(flat), scratch_(scratch) {}
+    void Run(GlyphContour& out) {
+      out.segments.clear();
+      out.contours.clear();
       out.advance_width = int16_t(font_.AdvanceWidth(glyph_id_));
       Visit(glyph_id_, 0, 0, out);
-      return out;
     }
 
    private:
     const FontLoader& font_;
     uint16_t glyph_id_;
     float flatness_;
+    ParseScratch& scratch_;
 
     void Visit(uint16_t gid, int32_t dx, int32_t dy, GlyphContour& out) {
       const uint8_t* gptr;
@@ -248,16 +305,20 @@ class FontLoader {
     void ParseSimple(const uint8_t* g, uint32_t, int32_t dx, int32_t dy,
                      GlyphContour& out) {
       int16_t n_contours = ReadS16(g);
+      if (n_contours <= 0) return;
       const uint8_t* ptr = g + 10;
-      std::vector<uint16_t> end_pts(n_contours);
+      // Composite parts are parsed one after another, never nested, so the
+      // scratch buffers can be shared by all of them.
+      auto& end_pts = scratch_.end_pts;
+      end_pts.resize(n_contours);
       for (int i = 0; i < n_contours; ++i) end_pts[i] = ReadU16(ptr + i * 2);
       ptr += n_contours * 2;
       uint16_t instr_len = ReadU16(ptr);
       ptr += 2 + instr_len;
       uint16_t n_pts = end_pts.back() + 1;
 
-      std::vector<uint8_t> flags;
-      flags.reserve(n_pts);
+      auto& flags = scratch_.flags;
+      flags.clear();
       for (uint16_t i = 0; i < n_pts;) {
         uint8_t f = *ptr++;
         flags.push_back(f);
@@ -271,7 +332,10 @@ class FontLoader {
         }
       }
 
-      std::vector<int16_t> xs(n_pts), ys(n_pts);
+      auto& xs = scratch_.xs;
+      auto& ys = scratch_.ys;
+      xs.resize(n_pts);
+      ys.resize(n_pts);
       for (uint16_t i = 0; i < n_pts; ++i) {
         if (flags[i] & 0x02) {
           uint8_t dx8 = *ptr++;
@@ -320,39 +384,56 @@ class FontLoader {
         return (i == last_idx) ? first_idx : uint16_t(i + 1);
       };
 
-      uint16_t start = first_idx;
-      while (!IsOn(start) && start != Next(start)) start = Next(start);
-
-      uint16_t i_prev = start;
-      auto [prev_x, prev_y] = Pt(i_prev);
-      bool prev_on = IsOn(i_prev);
-
-      for (uint16_t i_cur = Next(start);; i_cur = Next(i_cur)) {
-        bool cur_on;
-        float cur_x, cur_y;
-        std::tie(cur_x, cur_y) = Pt(i_cur);
-        cur_on = IsOn(i_cur);
-
-        if (prev_on && cur_on) {
-          AddLine(prev_x, prev_y, cur_x, cur_y, out);
-        } else if (prev_on && !cur_on) {
-        } else if (!prev_on && !cur_on) {
-          float mx = (prev_x + cur_x) * 0.5f;
-          float my = (prev_y + cur_y) * 0.5f;
-          AddQuad(prev_x, prev_y, prev_x, prev_y, mx, my, out);
-          prev_x = mx;
-          prev_y = my;
-          prev_on = true;
-          continue;
+      // Start on an on-curve point, or on the implied midpoint when the
+      // contour has none at its ends, and carry the pending off-curve point
+      // so every quad keeps its real start and control.
+      uint16_t begin = first_idx;
+      uint16_t count = n;
+      std::pair<float, float> first;
+      if (IsOn(first_idx)) {
+        first = Pt(first_idx);
+        begin = Next(first_idx);
+        --count;
+      } else if (IsOn(last_idx)) {
+        first = Pt(last_idx);
+        --count;
+      } else {
+        auto [ax, ay] = Pt(last_idx);
+        auto [bx, by] = Pt(first_idx);
+        first = {(ax + bx) * 0.5f, (ay + by) * 0.5f};
+      }
+
+      auto [prev_x, prev_y] = first;
+      float ctrl_x = 0, ctrl_y = 0;
+      bool has_ctrl = false;
+      for (uint16_t k = 0, i_cur = begin; k < count; ++k, i_cur = Next(i_cur)) {
+        auto [cur_x, cur_y] = Pt(i_cur);
+        if (IsOn(i_cur)) {
+          if (has_ctrl)
+            AddQuad(prev_x, prev_y, ctrl_x, ctrl_y, cur_x, cur_y, out);
+          else
+            AddLine(prev_x, prev_y, cur_x, cur_y, out);
+          prev_x = cur_x;
+          prev_y = cur_y;
+          has_ctrl = false;
         } else {
-          AddQuad(prev_x, prev_y, prev_x, prev_y, cur_x, cur_y, out);
+          if (has_ctrl) {
+            float mx = (ctrl_x + cur_x) * 0.5f;
+            float my = (ctrl_y + cur_y) * 0.5f;
+            AddQuad(prev_x, prev_y, ctrl_x, ctrl_y, mx, my, out);
+            prev_x = mx;
+            prev_y = my;
+          }
+          ctrl_x = cur_x;
+          ctrl_y = cur_y;
+          has_ctrl = true;
         }
-
-        if (i_cur == start) break;
-        prev_x = cur_x;
-        prev_y = cur_y;
-        prev_on = cur_on;
       }
+      if (has_ctrl)
+        AddQuad(prev_x, prev_y, ctrl_x, ctrl_y, first.first, first.second,
+                out);
+      else if (prev_x != first.first || prev_y != first.second)
+        AddLine(prev_x, prev_y, first.first, first.second, out);
     }
 
     void AddLine(float x0, float y0, float x1, float y1, GlyphContour& out) {
@@ -411,6 +492,37 @@ class FontLoader {
     }
   };
 
+  // Adds the point and contour counts of gid, following composite
+  // components up to a small depth so a malformed font cannot loop.
+  void CountPoints(uint16_t gid, GlyphBounds& out, int depth) const {
+    const uint8_t* g;
+    uint32_t len;
+    if (depth > 8 || !GlyphOffset(gid, g, len) || len < 10) return;
+    const int16_t n_contours = ReadS16(g);
+    if (n_contours > 0) {
+      if (len < 10u + 2u * n_contours) return;
+      out.points += ReadU16(g + 10 + 2 * (n_contours - 1)) + 1u;
+      out.contours += uint16_t(n_contours);
+      return;
+    }
+    if (n_contours == 0) return;
+    const uint8_t* ptr = g + 10;
+    const uint8_t* end = g + len;
+    uint16_t flags;
+    do {
+      if (ptr + 4 > end) return;
+      flags = ReadU16(ptr);
+      CountPoints(ReadU16(ptr + 2), out, depth + 1);
+      ptr += 4 + ((flags & 1) ? 4 : 2);
+      if (flags & 8)
+        ptr += 2;
+      else if (flags & 0x40)
+        ptr += 4;
+      else if (flags & 0x80)
+        ptr += 8;
+    } while (flags & 0x20);
+  }
+
   bool GlyphOffset(uint16_t gid, const uint8_t*& ptr, uint32_t& len) const {
     if (!glyf_ || !loca_ || gid >= num_glyphs_) return false;
     uint32_t offset, next;
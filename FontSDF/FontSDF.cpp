@@ -5,17 +5,40 @@
 #include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <span>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "AsyncWriter.h"
+#include "AtlasPacker.h"
+#include "Bc4Encoder.h"
 #include "FontLoader.h"
+#include "PngWriter.h"
+#include "SdfGenerator.h"
+#include "SdfMips.h"
+#include "SimdKernels.h"
+#include "TaskPool.h"
+#include "TextureContainer.h"
+#include "TileCache.h"
 #include "include/Serializer/SerializeDemo.h"
 
-using ttf::GlyphContour;
+using sdf::ChannelLayout;
+using sdf::ContainerFormat;
+using sdf::GlyphBox;
+using sdf::ImageFormat;
+using sdf::SdfConfig;
+using sdf::SdfEngine;
+using sdf::TextureCompression;
 #pragma pack(push, 1)
 struct FontAssetHeader {
   char magic[8];           
@@ -29,7 +52,7 @@ struct FontAssetHeader {
   int16_t descenderPX;     
   uint16_t lineAdvancePX;  
   uint16_t texW, texH;     
-  uint16_t reserved;       
+  uint16_t pageCount;      
   uint32_t glyphCount;
 };
 
@@ -43,275 +66,318 @@ struct GlyphRecord {
   uint8_t flags;               
 };
 #pragma pack(pop)
-static constexpr int kSupersample = 64;
-static constexpr int kRadiusPX = 5;
-static constexpr int kBorderPX = 4;
-static constexpr int kGlyphPX = 16;
-static constexpr int kAtlasW = 1024;
 
-struct GlyphMeta {
-  char32_t cp;
-  uint16_t u;
-  uint16_t v;
+// FontAssetHeader::flags bits 0-1: texel layout of the atlas payload.
+enum AssetFlags : uint16_t {
+  kAssetSdf = 0,    // 1 byte per texel
+  kAssetMsdf = 1,   // RGB, median of the three is the distance
+  kAssetMtsdf = 2,  // RGB as kAssetMsdf, A holds the true distance
+  kAssetChannelMask = 3,
+  kAssetBc4 = 4,  // payload in BC4 blocks, rows of texW / 4 blocks
+};
+
+// GlyphRecord::flags. A rotated glyph is stored turned 90 degrees clockwise:
+// its h x w footprint starts at (u, v) and glyph texel (x, y) lies at
+// (u + h - 1 - y, v + x). w and h always describe the upright glyph.
+enum GlyphFlags : uint8_t {
+  kGlyphRotated = 1,
 };
 
-struct BitPlane {
-  int w{}, h{}, pitch{};
-  std::vector<uint8_t> data;
-  BitPlane(int width, int height) : w(width), h(height) {
-    pitch = (w + 7) >> 3;
-    data.resize(pitch * h, 0);
+// Reads "key=value" tokens; unknown keys and malformed values are errors.
+static bool ParseConfig(std::istream& in, SdfConfig& cfg, std::string& err) {
+  static const std::pair<const char*, SdfEngine> engines[] = {
+      {"brute", SdfEngine::kBruteForce}, {"spiral", SdfEngine::kSpiral},
+      {"tiled", SdfEngine::kTiled},      {"rowspan", SdfEngine::kRowSpan},
+      {"pyramid", SdfEngine::kPyramid},  {"edt", SdfEngine::kExactEdt},
+      {"analytic", SdfEngine::kAnalytic},
+  };
+  static const std::pair<const char*, ChannelLayout> layouts[] = {
+      {"sdf", ChannelLayout::kSdf},
+      {"msdf", ChannelLayout::kMsdf},
+      {"mtsdf", ChannelLayout::kMtsdf},
+  };
+  static const std::pair<const char*, ImageFormat> images[] = {
+      {"bmp", ImageFormat::kBmp},
+      {"bmp8", ImageFormat::kBmp8},
+      {"png", ImageFormat::kPng},
+  };
+  static const std::pair<const char*, TextureCompression> compressions[] = {
+      {"none", TextureCompression::kNone},
+      {"bc4", TextureCompression::kBc4},
+  };
+  static const std::pair<const char*, ContainerFormat> containers[] = {
+      {"none", ContainerFormat::kNone},
+      {"ktx2", ContainerFormat::kKtx2},
+      {"dds", ContainerFormat::kDds},
+  };
+  std::string tok;
+  while (in >> tok) {
+    size_t eq = tok.find('=');
+    if (eq == std::string::npos) {
+      err = "expected key=value: " + tok;
+      return false;
+    }
+    const std::string key = tok.substr(0, eq), val = tok.substr(eq + 1);
+    int* num = key == "supersample" ? &cfg.supersample
+               : key == "radius"    ? &cfg.radius_px
+               : key == "border"    ? &cfg.border_px
+               : key == "glyph"     ? &cfg.glyph_px
+               : key == "atlas_w"   ? &cfg.atlas_w
+               : key == "atlas_h"   ? &cfg.atlas_h
+               : key == "mips"      ? &cfg.mip_levels
+                                    : nullptr;
+    bool ok = false;
+    if (key == "supersample" && val == "auto") {
+      cfg.supersample = 0;
+      ok = true;
+    } else if (key == "mips" && val == "auto") {
+      cfg.mip_levels = 0;
+      ok = true;
+    } else if (key == "max_error") {
+      char* end = nullptr;
+      float v = std::strtof(val.c_str(), &end);
+      ok = !val.empty() && *end == 0 && v > 0 && v < 1;
+      if (ok) cfg.max_error_em = v;
+    } else if (num) {
+      char* end = nullptr;
+      long v = std::strtol(val.c_str(), &end, 10);
+      ok = !val.empty() && *end == 0 && v > 0 && v <= 65535;
+      if (ok) *num = int(v);
+    } else if (key == "engine") {
+      for (auto& [name, e] : engines)
+        if (val == name) cfg.engine = e, ok = true;
+    } else if (key == "layout") {
+      for (auto& [name, l] : layouts)
+        if (val == name) cfg.layout = l, ok = true;
+    } else if (key == "image") {
+      for (auto& [name, f] : images)
+        if (val == name) cfg.image = f, ok = true;
+    } else if (key == "compress") {
+      for (auto& [name, c] : compressions)
+        if (val == name) cfg.compress = c, ok = true;
+    } else if (key == "container") {
+      for (auto& [name, c] : containers)
+        if (val == name) cfg.container = c, ok = true;
+    } else if (key == "cache") {
+      ok = !val.empty();
+      cfg.cache_path = val == "off" ? "" : val;
+    } else if (key == "rotate") {
+      ok = val == "0" || val == "1";
+      cfg.allow_rotate = val == "1";
+    } else if (key == "dedup") {
+      ok = val == "gid" || val == "content";
+      if (ok) cfg.dedup_content = val == "content";
+    } else {
+      err = "unknown setting: " + key;
+      return false;
+    }
+    if (!ok) {
+      err = "bad value for " + key + ": " + val;
+      return false;
+    }
+  }
+  if (cfg.supersample == 0) cfg.supersample = sdf::AutoSupersample(cfg);
+  if (cfg.supersample % 4 != 0) {
+    err = "supersample must be a multiple of 4";
+    return false;
+  }
+  if (cfg.HiSide() > sdf::kMaxHiSide ||
+      cfg.radius_px * cfg.supersample > 4096) {
+    err = "supersample too large for the glyph size or radius";
+    return false;
   }
-  void Set(int x, int y) { data[y * pitch + (x >> 3)] |= 0x80 >> (x & 7); }
-  bool Get(int x, int y) const {
-    if (x < 0 || y < 0 || x >= w || y >= h) return false;
-    return data[y * pitch + (x >> 3)] & (0x80 >> (x & 7));
+  if (cfg.atlas_w < cfg.LoSide() + 2 * cfg.border_px) {
+    err = "atlas_w smaller than one glyph tile";
+    return false;
   }
+  if (cfg.atlas_h < cfg.LoSide() + 2 * cfg.border_px) {
+    err = "atlas_h smaller than one glyph tile";
+    return false;
+  }
+  if (cfg.image == ImageFormat::kBmp8 && cfg.layout != ChannelLayout::kSdf) {
+    err = "image=bmp8 needs layout=sdf";
+    return false;
+  }
+  if (cfg.compress == TextureCompression::kBc4) {
+    if (cfg.layout != ChannelLayout::kSdf) {
+      err = "compress=bc4 needs layout=sdf";
+      return false;
+    }
+    if (cfg.atlas_w % 4 != 0) {
+      err = "compress=bc4 needs atlas_w to be a multiple of 4";
+      return false;
+    }
+  }
+  if (cfg.mip_levels && cfg.container == ContainerFormat::kNone) {
+    err = "mips needs container=ktx2 or container=dds";
+    return false;
+  }
+  return true;
+}
+
+// One code point's entry in the asset; see GlyphRecord.
+struct GlyphMeta {
+  char32_t cp;
+  uint16_t u, v, w, h;
+  int16_t bearing_x, bearing_y;
+  uint16_t advance;
+  uint8_t page;
+  uint8_t flags;
 };
-void WriteFontAsset(const std::string& root,
-                    const std::vector<GlyphMeta>& metas,
-                    const std::vector<uint8_t>& atlas, uint16_t texW,
-                    uint16_t texH, int16_t fontHeightPX, int16_t ascPX,
-                    int16_t descPX, uint16_t lineAdvancePX) {
 
-  char path[260];
-  sprintf_s(path, "%s.sdfb", root.c_str());
-  std::ofstream ofs(path, std::ios::binary);
-  if (!ofs) throw std::runtime_error("open sdfb fail");
+// Header and glyph records of the asset, in one buffer. The payload of
+// `pages` slices of texW x texH texels follows them directly; with kAssetBc4
+// each slice is texW * texH / 2 bytes of blocks.
+static std::vector<uint8_t> FontAssetHead(
+    const SdfConfig& cfg, const std::vector<GlyphMeta>& metas, uint16_t texW,
+    uint16_t texH, uint16_t pages, int16_t fontHeightPX, int16_t ascPX,
+    int16_t descPX, uint16_t lineAdvancePX) {
+  std::vector<uint8_t> out;
+  auto put = [&](const auto& v) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+    out.insert(out.end(), p, p + sizeof(v));
+  };
+  out.reserve(sizeof(FontAssetHeader) + metas.size() * sizeof(GlyphRecord));
 
   FontAssetHeader hd{};
   memcpy(hd.magic, "SDFONT1", 7);
   hd.major = 1;
-  hd.minor = 0;
-  hd.flags = 0;
-  hd.pixelSizePX = kGlyphPX;
-  hd.borderPX = kBorderPX;
-  hd.spreadPX = kRadiusPX;
+  hd.minor = 4;
+  hd.flags = cfg.layout == ChannelLayout::kMsdf    ? kAssetMsdf
+             : cfg.layout == ChannelLayout::kMtsdf ? kAssetMtsdf
+                                                   : kAssetSdf;
+  if (cfg.compress == TextureCompression::kBc4) hd.flags |= kAssetBc4;
+  hd.pixelSizePX = uint16_t(cfg.glyph_px);
+  hd.borderPX = uint16_t(cfg.border_px);
+  hd.spreadPX = uint16_t(cfg.radius_px);
   hd.fontHeightPX = fontHeightPX;
   hd.ascenderPX = ascPX;
   hd.descenderPX = descPX;
   hd.lineAdvancePX = lineAdvancePX;
   hd.texW = texW;
   hd.texH = texH;
+  hd.pageCount = pages;
   hd.glyphCount = static_cast<uint32_t>(metas.size());
-  ofs.write((char*)&hd, sizeof(hd));
+  put(hd);
 
   GlyphRecord gr{};
-  gr.w = gr.h = kGlyphPX;
-  gr.advance = kGlyphPX;
   for (auto& m : metas) {
     gr.codePoint = static_cast<uint32_t>(m.cp);
     gr.u = m.u;
     gr.v = m.v;
-    gr.bearingX = 0;
-    gr.bearingY = 0;
-    ofs.write((char*)&gr, sizeof(gr));
+    gr.w = m.w;
+    gr.h = m.h;
+    gr.bearingX = m.bearing_x;
+    gr.bearingY = m.bearing_y;
+    gr.advance = m.advance;
+    gr.atlasId = m.page;
+    gr.flags = m.flags;
+    put(gr);
   }
-
-  ofs.write((char*)atlas.data(), atlas.size());
-  ofs.close();
+  return out;
 }
-static void FlattenQuadR(float x0, float y0, float cx, float cy, float x1,
-                         float y1, float tol2,
-                         std::vector<std::pair<float, float>>& out) {
-  float mx = (x0 + 2 * cx + x1) * 0.25f;
-  float my = (y0 + 2 * cy + y1) * 0.25f;
-  float lx = (x0 + x1) * 0.5f;
-  float ly = (y0 + y1) * 0.5f;
-  float dx = mx - lx;
-  float dy = my - ly;
-  if (dx * dx + dy * dy <= tol2) {
-    out.emplace_back(x1, y1);
-    return;
-  }
-  float q0x = (x0 + cx) * 0.5f;
-  float q0y = (y0 + cy) * 0.5f;
-  float q1x = (cx + x1) * 0.5f;
-  float q1y = (cy + y1) * 0.5f;
-  float qmx = (q0x + q1x) * 0.5f;
-  float qmy = (q0y + q1y) * 0.5f;
-  FlattenQuadR(x0, y0, q0x, q0y, qmx, qmy, tol2, out);
-  FlattenQuadR(qmx, qmy, q1x, q1y, x1, y1, tol2, out);
+
+// tiles holds one boxes[t].w x boxes[t].h x Channels() tile per distinct
+// glyph, tile t starting at tile_at[t]; finished tiles are drawn into the
+// atlas from it.
+struct Shared {
+  const SdfConfig* cfg;
+  std::vector<uint8_t>* tiles;
+  const std::vector<size_t>* tile_at;
+  const std::vector<GlyphBox>* boxes;
+};
+
+// Atlas rows per output band. Bands are written as one block each, so they
+// stay large enough to keep the disk streaming.
+static constexpr int kOutputRows = 256;
+
+// Relative cost of a glyph: the hi-res raster grows with the tile area and
+// the band along the outline with the number of outline points.
+static uint32_t GlyphCost(const GlyphBox& box, const ttf::GlyphBounds& b) {
+  return uint32_t(box.w * box.h) + b.points;
 }
 
-static void RasterOutline(const GlyphContour& g, BitPlane& bmp) {
-  if (g.segments.empty()) return;
-  float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
-  for (auto& s : g.segments) {
-    min_x = std::min({min_x, s.x0, s.cx, s.x1});
-    min_y = std::min({min_y, s.y0, s.cy, s.y1});
-    max_x = std::max({max_x, s.x0, s.cx, s.x1});
-    max_y = std::max({max_y, s.y0, s.cy, s.y1});
-  }
-  const float drawable = kGlyphPX * kSupersample;
-  float scale = drawable / std::max(max_x - min_x, max_y - min_y);
-  float off_x = kBorderPX * kSupersample - min_x * scale;
-  float off_y = kBorderPX * kSupersample - min_y * scale;
-
-  const float tol2 = 1.0f / (512.0f * 512.0f);
-  std::vector<std::pair<float, float>> poly;
-  std::vector<float> x_int;
-  for (int sy = 0; sy < bmp.h; ++sy) {
-    float py_unit = (bmp.h - 1 - sy + 0.5f - off_y) / scale;
-    x_int.clear();
-    for (size_t c = 0; c < g.contours.size(); ++c) {
-      size_t b = g.contours[c];
-      size_t e =
-          (c + 1 == g.contours.size()) ? g.segments.size() : g.contours[c + 1];
-      poly.clear();
-      for (size_t i = b; i < e; ++i) {
-        const auto& s = g.segments[i];
-        poly.emplace_back(s.x0, s.y0);
-        if (s.cx == (s.x0 + s.x1) * 0.5f && s.cy == (s.y0 + s.y1) * 0.5f)
-          poly.emplace_back(s.x1, s.y1);
-        else
-          FlattenQuadR(s.x0, s.y0, s.cx, s.cy, s.x1, s.y1, tol2, poly);
-      }
-      if (poly.size() < 2) continue;
-      for (size_t i = 0, N = poly.size(); i < N; ++i) {
-        auto [x0, y0] = poly[i];
-        auto [x1, y1] = poly[(i + 1) % N];
-        if ((y0 > py_unit) != (y1 > py_unit)) {
-          float t = (py_unit - y0) / (y1 - y0);
-          x_int.push_back(x0 + t * (x1 - x0));
-        }
-      }
-    }
-    if (x_int.size() < 2) continue;
-    std::sort(x_int.begin(), x_int.end());
-    const float eps = 1e-5f;
-    size_t w = 0;
-    for (size_t i = 0; i < x_int.size(); ++i)
-      if (w == 0 || std::fabs(x_int[i] - x_int[w - 1]) > eps)
-        x_int[w++] = x_int[i];
-    x_int.resize(w);
-    for (size_t k = 0; k + 1 < x_int.size(); k += 2) {
-      int sx0 = int(x_int[k] * scale + off_x);
-      int sx1 = int(x_int[k + 1] * scale + off_x);
-      sx0 = std::clamp(sx0, 0, bmp.w - 1);
-      sx1 = std::clamp(sx1, 0, bmp.w - 1);
-      for (int sx = sx0; sx <= sx1; ++sx) bmp.Set(sx, sy);
-    }
-  }
+// Bump whenever a change alters the bytes any engine produces, so tiles
+// cached by an older build are not picked up.
+static constexpr int32_t kTileVersion = 3;
+
+// Everything apart from the font and the glyph that decides a tile's bytes.
+static uint64_t TileParamsHash(const SdfConfig& cfg) {
+  const int32_t v[] = {kTileVersion,      cfg.supersample,
+                       cfg.radius_px,     cfg.border_px,
+                       cfg.glyph_px,      int32_t(cfg.engine),
+                       int32_t(cfg.layout)};
+  return sdf::Fnv1a(v, sizeof(v));
 }
 
-inline bool ReadCanvasBit(const BitPlane& bmp, int32_t xo, int32_t yo, int x,
-                          int y) {
-  x -= xo;
-  y -= yo;
-  if (x < 0 || y < 0 || x >= bmp.w || y >= bmp.h) return false;
-  return bmp.Get(x, y);
+// Task for one distinct glyph: generate it, splitting into bands on the
+// pool, and store it as tile number tile.
+static void BuildGlyph(const ttf::FontLoader& font, uint16_t gid,
+                       size_t tile, Shared& sh, sdf::TaskPool& pool) {
+  const SdfConfig& cfg = *sh.cfg;
+  const GlyphBox& box = (*sh.boxes)[tile];
+
+  sdf::GlyphScratch& gs = sdf::ThreadGlyphScratch();
+  font.Extract(gid, sdf::OutlineFlatness(font, cfg), gs.outline, gs.parse);
+
+  std::vector<uint8_t>& sdf = gs.sdf;
+  sdf.resize(size_t(box.w) * box.h * cfg.Channels());
+  sdf::GenerateSdf(gs.outline, box, cfg, pool, gs, sdf);
+  std::memcpy(&(*sh.tiles)[(*sh.tile_at)[tile]], sdf.data(), sdf.size());
 }
 
-static float DistanceSq(const BitPlane& bmp, int xo, int yo, int x, int y,
-                        bool from_inside) {
-  const int R = kRadiusPX * kSupersample;
-  int cx = x * kSupersample + 7;
-  int cy = y * kSupersample + 7;
-  int best = R * R;
-  for (int dy = -R; dy <= R; dy += 2) {
-    int yy = cy + dy;
-    int dyy = dy * dy;
-    if (dyy >= best) break;
-    for (int dx = -R; dx <= R; dx += 2) {
-      int dxx = dx * dx;
-      int dsq = dxx + dyy;
-      if (dsq >= best) continue;
-      bool pix = ReadCanvasBit(bmp, xo, yo, (cx + dx), (cy + dy));
-      if (pix != from_inside) {
-        best = dsq;
-        if (best == 0) return 0;
+// Points every entry of cell_of at the first tile of the same size with the
+// same bytes. Tiles are bucketed by FNV-1a and compared in full, so a hash
+// collision never merges two different glyphs. Only texels are shared:
+// advance and bearings stay with each glyph's own tile.
+static void MergeIdenticalTiles(const std::vector<uint8_t>& tiles,
+                                const std::vector<size_t>& tile_at,
+                                const std::vector<GlyphBox>& boxes,
+                                std::vector<uint32_t>& cell_of) {
+  const uint32_t n = uint32_t(boxes.size());
+  std::vector<uint32_t> same(n);
+  std::unordered_multimap<uint64_t, uint32_t> seen;
+  for (uint32_t t = 0; t < n; ++t) {
+    const uint8_t* a = &tiles[tile_at[t]];
+    const size_t bytes = tile_at[t + 1] - tile_at[t];
+    const int dims[2] = {boxes[t].w, boxes[t].h};
+    const uint64_t h = sdf::Fnv1a(a, bytes, sdf::Fnv1a(dims, sizeof(dims)));
+    same[t] = t;
+    auto [lo, hi] = seen.equal_range(h);
+    for (auto it = lo; it != hi; ++it) {
+      const uint32_t o = it->second;
+      if (boxes[o].w == dims[0] && boxes[o].h == dims[1] &&
+          !std::memcmp(a, &tiles[tile_at[o]], bytes)) {
+        same[t] = o;
+        break;
       }
     }
+    if (same[t] == t) seen.emplace(h, t);
   }
-  return float(best) / (R * R);
+  for (uint32_t& t : cell_of) t = same[t];
 }
 
-struct Shared {
-  std::atomic_uint next{0};
-  std::vector<GlyphMeta>* metas;
-  std::vector<uint8_t>* atlas;
-  int atlas_pitch;
-};
-
-static void Worker(const ttf::FontLoader& font, std::vector<char32_t>& cps,
-                   Shared& sh) {
-  const float flatness = font.UnitsPerEm() / float(kGlyphPX * 16);
-
-  const int hi_side = (kGlyphPX + 2 * kBorderPX) * kSupersample;
-  const int lo_side = kGlyphPX + 2 * kBorderPX;
-  const int R = kRadiusPX * kSupersample;
-  const int R2 = R * R;
-
-  for (;;) {
-    size_t idx = sh.next.fetch_add(1, std::memory_order_relaxed);
-    if (idx >= cps.size()) break;
-
-    uint16_t gid = font.GlyphId(cps[idx]);
-    if (!gid) continue;
-
-    GlyphContour outline = font.Extract(gid, flatness);
-
-    BitPlane hi(hi_side, hi_side);
-    RasterOutline(outline, hi);
-
-    std::vector<uint8_t> sdf(lo_side * lo_side);
-
-    for (int y = 0; y < lo_side; ++y)
-      for (int x = 0; x < lo_side; ++x) {
-        const int step = kSupersample / 4;
-        const int half = step >> 1;
-        int in_cnt = 0;
-        for (int sy = 0; sy < 4; ++sy)
-          for (int sx = 0; sx < 4; ++sx) {
-            int hx = x * kSupersample + sx * step + half;
-            int hy = y * kSupersample + sy * step + half;
-            in_cnt += hi.Get(hx, hy);
-          }
-        bool inside = in_cnt >= 8;
-
-        int cx = x * kSupersample + kSupersample / 2;
-        int cy = y * kSupersample + kSupersample / 2;
-        int best = R2;
-        for (int dy = -R; dy <= R; ++dy) {
-          int yy = cy + dy;
-          int dyy = dy * dy;
-          if (dyy >= best) continue;
-          for (int dx = -R; dx <= R; ++dx) {
-            int dxx = dx * dx;
-            int d2 = dxx + dyy;
-            if (d2 >= best) continue;
-            bool pix = hi.Get(cx + dx, yy);
-            if (pix != inside) best = d2;
-          }
-        }
-        float norm = std::sqrt(float(best)) / float(R);
-        float signed_n = inside ? norm : -norm;
-        uint8_t v =
-            uint8_t(std::clamp(128.0f + signed_n * 127.0f, 0.0f, 255.0f));
-        sdf[y * lo_side + x] = v;
-      }
-
-    const GlyphMeta& m = (*sh.metas)[idx];
-    int dst_y = m.v - kBorderPX;
-    int dst_x = m.u - kBorderPX;
+// Bytes per BMP pixel for `channels` bytes per texel (1, 3 or 4). One
+// channel is stored as gray, as 8-bit indices into a gray ramp when indexed;
+// three are stored as RGB and four as 32-bit RGBA.
+static int BmpPixelBytes(int channels, bool indexed) {
+  return indexed ? 1 : channels == 4 ? 4 : 3;
+}
 
-    for (int y = 0; y < lo_side; ++y) {
-      std::memcpy(&(*sh.atlas)[(dst_y + y) * sh.atlas_pitch + dst_x],
-                  &sdf[y * lo_side], lo_side);
-    }
-  }
+static int BmpStride(int w, int pixel_bytes) {
+  return (w * pixel_bytes + 3) & ~3;
 }
 
-static void WriteBmp(const std::wstring& path, int w, int h,
-                     const uint8_t* buf) {
-  uint32_t row_bytes = w * 3;
-  uint32_t padding = (4 - (row_bytes & 3)) & 3;
-  uint32_t image_bytes = (row_bytes + padding) * h;
+// File and info headers, plus the palette for 8-bit pixels, of a top-down
+// w x h image; pixel rows follow, BmpStride() apart.
+static std::vector<uint8_t> BmpHead(int w, int h, int pixel_bytes) {
+  const uint32_t colors = pixel_bytes == 1 ? 256 : 0;
+  uint32_t image_bytes = uint32_t(BmpStride(w, pixel_bytes)) * h;
 
   BITMAPFILEHEADER bf = {};
   bf.bfType = 0x4D42;
-  bf.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+  bf.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) +
+                 colors * sizeof(RGBQUAD);
   bf.bfSize = bf.bfOffBits + image_bytes;
 
   BITMAPINFOHEADER bi = {};
@@ -319,30 +385,48 @@ static void WriteBmp(const std::wstring& path, int w, int h,
   bi.biWidth = static_cast<int32_t>(w);
   bi.biHeight = -static_cast<int32_t>(h);
   bi.biPlanes = 1;
-  bi.biBitCount = 24;
+  bi.biBitCount = uint16_t(pixel_bytes * 8);
   bi.biCompression = BI_RGB;
   bi.biSizeImage = image_bytes;
   bi.biXPelsPerMeter = 0x0EC4;
   bi.biYPelsPerMeter = 0x0EC4;
+  bi.biClrUsed = colors;
+
+  std::vector<uint8_t> out(bf.bfOffBits);
+  std::memcpy(out.data(), &bf, sizeof(bf));
+  std::memcpy(out.data() + sizeof(bf), &bi, sizeof(bi));
+  RGBQUAD* palette =
+      reinterpret_cast<RGBQUAD*>(out.data() + sizeof(bf) + sizeof(bi));
+  for (uint32_t i = 0; i < colors; ++i)
+    palette[i] = {uint8_t(i), uint8_t(i), uint8_t(i), 0};
+  return out;
+}
 
-  std::ofstream ofs(path, std::ios::binary);
-  if (!ofs) throw std::runtime_error("Cannot open bmp for writing");
-
-  ofs.write(reinterpret_cast<const char*>(&bf), sizeof(bf));
-  ofs.write(reinterpret_cast<const char*>(&bi), sizeof(bi));
-
-  std::vector<uint8_t> pad(padding, 0);
-  std::vector<uint8_t> row(row_bytes);
-
-  for (uint32_t y = 0; y < h; ++y) {
-    const uint8_t* src = buf + y * w;
-    uint8_t* dst = row.data();
-    for (uint32_t x = 0; x < w; ++x, dst += 3)
-      dst[0] = dst[1] = dst[2] = src[x];
-    ofs.write(reinterpret_cast<const char*>(row.data()), row_bytes);
-    if (padding) ofs.write(reinterpret_cast<const char*>(pad.data()), padding);
+// Appends `rows` rows of w texels from buf to out in BMP layout, padding
+// included.
+static void EncodeBmpRows(const uint8_t* buf, int w, int rows, int channels,
+                          int pixel_bytes, std::vector<uint8_t>& out) {
+  const size_t stride = size_t(BmpStride(w, pixel_bytes));
+  const size_t at = out.size();
+  out.resize(at + stride * rows, 0);
+  for (int y = 0; y < rows; ++y) {
+    const uint8_t* src = buf + size_t(y) * w * channels;
+    uint8_t* dst = &out[at + y * stride];
+    if (pixel_bytes == 1) {
+      std::memcpy(dst, src, w);
+      continue;
+    }
+    for (int x = 0; x < w; ++x, dst += pixel_bytes, src += channels) {
+      if (channels == 1) {
+        dst[0] = dst[1] = dst[2] = src[0];
+        continue;
+      }
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      if (pixel_bytes == 4) dst[3] = src[3];
+    }
   }
-  ofs.close();
 }
 template <typename... Args>
 class EventSlim {
@@ -417,6 +501,17 @@ int wmain(int argc, wchar_t** argv) {
   std::string chars;
   settings >> font_path >> chars;
 
+  SdfConfig cfg;
+  std::string cfg_err;
+  if (!ParseConfig(settings, cfg, cfg_err)) {
+    std::wcerr << L"Settings: " << cfg_err.c_str() << L"\n";
+    return -1;
+  }
+  const int border = cfg.border_px;
+  const int glyph_px = cfg.glyph_px;
+  const int atlas_w = cfg.atlas_w;
+  const int channels = cfg.Channels();
+
   std::ifstream in(font_path, std::ios::binary | std::ios::ate);
   if (!in) {
     std::wcerr << L"font open fail";
@@ -457,50 +552,415 @@ int wmain(int argc, wchar_t** argv) {
 
   auto cps = decode(chars);
 
-  std::vector<GlyphMeta> metas(cps.size());
-  int cur_x = kBorderPX, cur_y = kBorderPX, row_h = 0, atlas_h = kBorderPX;
-  for (size_t i = 0; i < cps.size(); ++i) {
-    if (cur_x + kGlyphPX + 2 * kBorderPX > kAtlasW) {
-      cur_x = kBorderPX;
-      cur_y += row_h + kBorderPX;
-      row_h = 0;
+  // Code points that map to the same glyph share one tile.
+  std::vector<uint32_t> tile_of(cps.size());
+  std::vector<uint16_t> tile_gid;
+  {
+    std::unordered_map<uint16_t, uint32_t> by_gid;
+    for (size_t i = 0; i < cps.size(); ++i) {
+      auto [it, fresh] = by_gid.try_emplace(font.GlyphId(cps[i]),
+                                            uint32_t(tile_gid.size()));
+      if (fresh) tile_gid.push_back(it->first);
+      tile_of[i] = it->second;
     }
-    metas[i] = {cps[i], uint16_t(cur_x + kBorderPX),
-                uint16_t(cur_y + kBorderPX)};
-    cur_x += kGlyphPX + 2 * kBorderPX;
-    row_h = kGlyphPX + 2 * kBorderPX;
-    atlas_h = std::max(atlas_h, cur_y + row_h + kBorderPX);
   }
-
-  std::vector<uint8_t> atlas(kAtlasW * atlas_h, 0);
-  Shared sh{0, &metas, &atlas, kAtlasW};
+  // Tiles follow each glyph's own box at one scale for the whole font;
+  // empty glyphs and missing ones get no tile.
+  const float em_scale = glyph_px / font.UnitsPerEm();
+  const size_t n_tiles = tile_gid.size();
+  std::vector<GlyphBox> boxes(n_tiles, GlyphBox{em_scale, 0, 0, 0, 0});
+  std::vector<size_t> tile_at(n_tiles + 1, 0);
+  std::vector<std::pair<uint32_t, size_t>> order;
+  int widest = 0;
+  for (size_t t = 0; t < n_tiles; ++t) {
+    ttf::GlyphBounds b;
+    if (tile_gid[t] && font.Bounds(tile_gid[t], b)) {
+      boxes[t] = sdf::BoxOf(b, em_scale, border);
+      order.emplace_back(GlyphCost(boxes[t], b), t);
+      widest = std::max({widest, boxes[t].w, boxes[t].h});
+    }
+    tile_at[t + 1] =
+        tile_at[t] + size_t(boxes[t].w) * boxes[t].h * channels;
+  }
+  // ParseConfig bounded the em square; wide ligatures, tall accents and
+  // oversized outlines can still go past it.
+  if (int64_t(widest) * cfg.supersample > sdf::kMaxHiSide) {
+    std::wcerr << L"Settings: supersample too large for the largest glyph\n";
+    return -1;
+  }
+  std::vector<uint8_t> tiles(tile_at.back(), 0);
+  Shared sh{&cfg, &tiles, &tile_at, &boxes};
+  sdf::TileCache cache(cfg.cache_path, sdf::Fnv1a(buf.data(), buf.size()),
+                       TileParamsHash(cfg));
   
   // 時間測定
   auto start = std::chrono::high_resolution_clock::now();
 
 
-  std::vector<std::thread> pool;
-  for (int t = 0; t < std::thread::hardware_concurrency(); ++t)
-    pool.emplace_back(Worker, std::cref(font), std::ref(cps), std::ref(sh));
-  for (auto& t : pool) t.join();
+  std::wcout << L"Distance kernels: " << sdf::Kernels().name
+             << L", supersample " << cfg.supersample << L"x\n";
+  if (cfg.compress == TextureCompression::kBc4)
+    std::wcout << L"BC4 kernel: " << sdf::Bc4().name << L"\n";
+
+  // Largest first, so an expensive glyph near the end of the list cannot
+  // decide the tail; bands and stealing even out the rest.
+  std::stable_sort(
+      order.begin(), order.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+  // Only glyphs missing from the cache are generated.
+  auto tile_bytes = [&](size_t t) { return tile_at[t + 1] - tile_at[t]; };
+  std::vector<size_t> fresh, cached;
+  for (const auto& [cost, t] : order) {
+    if (cache.Load(tile_gid[t], &tiles[tile_at[t]], tile_bytes(t)))
+      cached.push_back(t);
+    else
+      fresh.push_back(t);
+  }
+
+  // Tiles still in use are packed tallest first, which keeps the skyline
+  // flat; every code point then points at its tile's cell. A tile that does
+  // not fit the current page closes it and opens the next.
+  struct Cell {
+    int x, y;
+    bool rotated;
+    uint8_t page;
+  };
+  std::vector<Cell> cells(n_tiles);
+  // Tile whose cell holds the texels of each tile; itself unless merged.
+  std::vector<uint32_t> cell_of(n_tiles);
+  std::iota(cell_of.begin(), cell_of.end(), 0u);
+  std::vector<std::vector<uint32_t>> pages;
+  std::vector<uint32_t> used;
+  int tex_h = 1;
+  const bool bc4 = cfg.compress == TextureCompression::kBc4;
+  auto pack = [&] {
+    std::vector<bool> seen(n_tiles, false);
+    for (uint32_t t : tile_of) {
+      const uint32_t c = cell_of[t];
+      if (boxes[c].w && !seen[c]) seen[c] = true, used.push_back(c);
+    }
+    std::stable_sort(used.begin(), used.end(), [&](uint32_t a, uint32_t b) {
+      return boxes[a].h != boxes[b].h ? boxes[a].h > boxes[b].h
+                                      : boxes[a].w > boxes[b].w;
+    });
+    pages.assign(1, {});
+    sdf::SkylinePacker packer(atlas_w, cfg.atlas_h);
+    for (uint32_t t : used) {
+      Cell& c = cells[t];
+      auto insert = [&] {
+        return packer.Insert(boxes[t].w, boxes[t].h, cfg.allow_rotate, c.x,
+                             c.y, c.rotated);
+      };
+      if (!insert()) {
+        tex_h = std::max(tex_h, packer.Height());
+        packer = sdf::SkylinePacker(atlas_w, cfg.atlas_h);
+        pages.emplace_back();
+        if (!insert() || pages.size() > 256) {
+          std::wcerr << L"Glyph " << tile_gid[t]
+                     << L" does not fit an atlas page\n";
+          return false;
+        }
+      }
+      c.page = uint8_t(pages.size() - 1);
+      pages.back().push_back(t);
+    }
+    tex_h = std::max(tex_h, packer.Height());
+    if (bc4) tex_h = (tex_h + 3) & ~3;  // whole blocks
+    return true;
+  };
+
+  // A page is allocated when its first tile is drawn and leaves in bands of
+  // kOutputRows rows, a band as soon as the last tile reaching into it is
+  // drawn. The writer thread encodes the page images and stores every file
+  // while glyphs are still being generated, and frees the page once the
+  // last job reading it is done. Bands no tile reaches come from `blank`.
+  // BC4 blocks are encoded on the pool instead, where they do not hold up
+  // the other files.
+  const size_t pitch = size_t(atlas_w) * channels;
+  sdf::TaskPool pool(std::thread::hardware_concurrency());
+  const bool png = cfg.image == ImageFormat::kPng;
+  const int bmp_bytes =
+      BmpPixelBytes(channels, cfg.image == ImageFormat::kBmp8);
+  const size_t bmp_stride = size_t(BmpStride(atlas_w, bmp_bytes));
+  sdf::AsyncWriter writer;
+  sdf::AsyncWriter::File* asset_file = nullptr;
+  std::vector<sdf::AsyncWriter::File*> image_files;
+  std::vector<uint8_t> head, bmp_head;
+  std::vector<std::vector<uint8_t>> atlas;
+  std::unique_ptr<std::once_flag[]> atlas_once;
+  std::vector<uint8_t> blank(kOutputRows * pitch, 0);
+  std::vector<std::vector<uint8_t>> blocks;  // BC4 payload per band
+  std::unique_ptr<std::atomic<int>[]> waiting;  // undrawn tiles per band
+  std::vector<uint8_t> band_empty;              // no tile reaches the band
+  std::unique_ptr<std::atomic<int>[]> page_jobs;  // writes still reading
+  int bands = 0;                                  // per page
+  // The texture file is built from whole pages after the last band.
+  const bool keep_pages = cfg.container != ContainerFormat::kNone;
+  auto page_texels = [&](int page) {
+    std::call_once(atlas_once[page],
+                   [&] { atlas[page].assign(pitch * tex_h, 0); });
+    return atlas[page].data();
+  };
+  auto page_written = [&](int page) {
+    return [&, page] {
+      if (page_jobs[page].fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+          !keep_pages)
+        std::vector<uint8_t>().swap(atlas[page]);
+    };
+  };
+  auto image_name = [&](size_t page) {
+    const wchar_t* ext = png ? L".png" : L".bmp";
+    return pages.size() == 1
+               ? L"atlas_super" + std::wstring(ext)
+               : L"atlas_super_" + std::to_wstring(page) + ext;
+  };
+  // A PNG takes its rows in order, so bands that finish early wait in
+  // png_ready until the ones above them are in.
+  std::vector<std::unique_ptr<sdf::PngEncoder>> png_pages;
+  std::vector<uint8_t> png_ready;
+  std::vector<int> png_next;  // first band of each page not yet handed on
+  std::mutex png_mutex;
+
+  auto emit = [&](int band) {
+    const int page = band / bands, y0 = band % bands * kOutputRows;
+    const int rows = std::min(kOutputRows, tex_h - y0);
+    const uint8_t* src =
+        band_empty[band] ? blank.data() : &atlas[page][y0 * pitch];
+    if (bc4) {
+      // kOutputRows and tex_h are multiples of 4, so bands hold whole blocks.
+      std::vector<uint8_t>& out = blocks[band];
+      out.resize(sdf::Bc4Size(atlas_w, rows));
+      const size_t row_bytes = sdf::Bc4Size(atlas_w, 4);
+      pool.ParallelFor(0, rows / 4, 8, [&](int b, int e) {
+        sdf::EncodeBc4Rows(src, atlas_w, b, e, &out[b * row_bytes]);
+      });
+      writer.Write(asset_file,
+                   head.size() + sdf::Bc4Size(atlas_w, page * tex_h + y0),
+                   out);
+    } else {
+      writer.Write(asset_file,
+                   head.size() + (uint64_t(page) * tex_h + y0) * pitch,
+                   std::span<const uint8_t>(src, rows * pitch),
+                   page_written(page));
+    }
+    if (!png) {
+      writer.Write(
+          image_files[page], bmp_head.size() + y0 * bmp_stride,
+          [=](std::vector<uint8_t>& out) {
+            EncodeBmpRows(src, atlas_w, rows, channels, bmp_bytes, out);
+          },
+          page_written(page));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(png_mutex);
+    png_ready[band] = 1;
+    for (int& b = png_next[page]; b < bands && png_ready[page * bands + b];
+         ++b) {
+      const int y = b * kOutputRows, n = std::min(kOutputRows, tex_h - y);
+      const bool last = b + 1 == bands;
+      const uint8_t* p = band_empty[page * bands + b]
+                             ? blank.data()
+                             : &atlas[page][y * pitch];
+      writer.Append(
+          image_files[page],
+          [=, enc = png_pages[page].get()](std::vector<uint8_t>& out) {
+            enc->AddRows(p, n, out);
+            if (last) enc->End(out);
+          },
+          page_written(page));
+    }
+  };
+
+  // Copies tile t into its cell; safe to run for different tiles at once.
+  auto draw = [&](uint32_t t) {
+    const Cell& c = cells[t];
+    const int w = boxes[t].w, h = boxes[t].h;
+    const uint8_t* src = &tiles[tile_at[t]];
+    uint8_t* dst = page_texels(c.page) + c.y * pitch + c.x * channels;
+    for (int y = 0; y < h; ++y) {
+      const uint8_t* row = src + size_t(y) * w * channels;
+      if (!c.rotated) {
+        std::memcpy(dst + y * pitch, row, size_t(w) * channels);
+        continue;
+      }
+      for (int x = 0; x < w; ++x)
+        std::memcpy(dst + x * pitch + (h - 1 - y) * channels,
+                    row + x * channels, channels);
+    }
+    const int bottom = c.y + (c.rotated ? w : h) - 1;
+    for (int b = c.y / kOutputRows; b <= bottom / kOutputRows; ++b) {
+      const int band = c.page * bands + b;
+      if (waiting[band].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        emit(band);
+    }
+  };
+
+  // Once packed: records, headers and the band counts; bands no tile
+  // touches leave right away.
+  auto begin_output = [&] {
+    // u, v, w, h and the bearings describe the glyph without its border.
+    std::vector<GlyphMeta> metas(cps.size());
+    for (size_t i = 0; i < cps.size(); ++i) {
+      const uint32_t t = tile_of[i];
+      const GlyphBox& box = boxes[t];
+      GlyphMeta& m = metas[i];
+      m = {};
+      m.cp = cps[i];
+      m.advance = uint16_t(
+          std::lround(font.AdvanceWidth(tile_gid[t]) * em_scale));
+      if (!box.w) continue;
+      const Cell& c = cells[cell_of[t]];
+      m.u = uint16_t(c.x + border);
+      m.v = uint16_t(c.y + border);
+      m.w = uint16_t(box.w - 2 * border);
+      m.h = uint16_t(box.h - 2 * border);
+      m.bearing_x = int16_t(box.left + border);
+      m.bearing_y = int16_t(box.top - border);
+      m.page = c.page;
+      m.flags = c.rotated ? kGlyphRotated : 0;
+    }
+    std::wcout << cps.size() << L" code points, " << n_tiles << L" glyphs, "
+               << used.size() << L" atlas cells on " << pages.size()
+               << L" page(s)\n";
+
+    const int16_t asc = int16_t(std::lround(font.Ascender() * em_scale));
+    const int16_t desc = int16_t(std::lround(font.Descender() * em_scale));
+    const int16_t fH = asc - desc;
+    const uint16_t advY =
+        uint16_t(fH + std::lround(font.LineGap() * em_scale));
+    head = FontAssetHead(cfg, metas, uint16_t(atlas_w), uint16_t(tex_h),
+                         uint16_t(pages.size()), fH, asc, desc, advY);
+    asset_file = writer.Open("atlas_super.sdfb");
+    writer.Write(asset_file, 0, head);
+
+    bmp_head = BmpHead(atlas_w, tex_h, bmp_bytes);
+    bands = (tex_h + kOutputRows - 1) / kOutputRows;
+    const int n_bands = int(pages.size()) * bands;
+    waiting = std::make_unique<std::atomic<int>[]>(n_bands);
+    png_ready.assign(n_bands, 0);
+    blocks.resize(bc4 ? n_bands : 0);
+    png_next.assign(pages.size(), 0);
+    atlas.assign(pages.size(), {});
+    atlas_once = std::make_unique<std::once_flag[]>(pages.size());
+    // Each band is read by its image job, and by its asset job unless that
+    // takes BC4 blocks encoded beforehand.
+    page_jobs = std::make_unique<std::atomic<int>[]>(pages.size());
+    for (size_t p = 0; p < pages.size(); ++p)
+      page_jobs[p] = bands * (bc4 ? 1 : 2);
+    for (size_t p = 0; p < pages.size(); ++p) {
+      image_files.push_back(writer.Open(image_name(p)));
+      if (png) {
+        png_pages.push_back(
+            std::make_unique<sdf::PngEncoder>(atlas_w, tex_h, channels));
+        writer.Append(image_files.back(),
+                      [enc = png_pages.back().get()](
+                          std::vector<uint8_t>& out) { enc->Begin(out); });
+      } else {
+        writer.Write(image_files.back(), 0, bmp_head);
+      }
+      for (uint32_t t : pages[p]) {
+        const Cell& c = cells[t];
+        const int bottom =
+            c.y + (c.rotated ? boxes[t].w : boxes[t].h) - 1;
+        for (int b = c.y / kOutputRows; b <= bottom / kOutputRows; ++b)
+          ++waiting[p * bands + b];
+      }
+    }
+    band_empty.assign(n_bands, 0);
+    for (int b = 0; b < n_bands; ++b)
+      band_empty[b] = waiting[b].load() == 0;
+    for (int b = 0; b < n_bands; ++b)
+      if (band_empty[b]) emit(b);
+  };
+
+  // Packing needs only the boxes, so unless tiles are merged by content the
+  // atlas is laid out before the first glyph is generated.
+  const bool stream = !cfg.dedup_content;
+  if (stream) {
+    if (!pack()) return -1;
+    begin_output();
+    // Page by page, so each page fills, leaves and is freed before the
+    // next ones are allocated; cost order still holds within a page.
+    auto by_page = [&](size_t a, size_t b) {
+      return cells[a].page < cells[b].page;
+    };
+    std::stable_sort(fresh.begin(), fresh.end(), by_page);
+    std::stable_sort(cached.begin(), cached.end(), by_page);
+  }
+  for (size_t t : fresh)
+    pool.Submit([&, t] {
+      BuildGlyph(font, tile_gid[t], t, sh, pool);
+      if (stream) draw(uint32_t(t));
+    });
+  if (stream)
+    for (size_t t : cached) draw(uint32_t(t));
+  pool.Wait();
+  for (size_t t : fresh)
+    cache.Add(tile_gid[t], &tiles[tile_at[t]], tile_bytes(t));
+  if (!cache.Flush())
+    std::wcerr << L"Tile cache not written: " << cfg.cache_path.c_str()
+               << L"\n";
+  std::wcout << fresh.size() << L" glyphs generated, " << cached.size()
+             << L" from cache\n";
+
+  if (!stream) {
+    MergeIdenticalTiles(tiles, tile_at, boxes, cell_of);
+    if (!pack()) return -1;
+    begin_output();
+    for (uint32_t t : used) draw(t);
+  }
+
+  // The texture file needs whole pages, so it comes last; pages build their
+  // mip chains side by side.
+  const bool ktx2 = cfg.container == ContainerFormat::kKtx2;
+  const wchar_t* texture_name = ktx2 ? L"atlas_super.ktx2" : L"atlas_super.dds";
+  sdf::TextureImage texture;
+  std::vector<uint8_t> texture_file;
+  if (cfg.container != ContainerFormat::kNone) {
+    texture.format = bc4             ? sdf::TexelFormat::kBc4
+                     : channels == 1 ? sdf::TexelFormat::kR8
+                                     : sdf::TexelFormat::kRgba8;
+    texture.w = atlas_w;
+    texture.h = tex_h;
+    texture.layers = int(pages.size());
+    const int full = sdf::FullMipLevels(atlas_w, tex_h);
+    const int levels = cfg.mip_levels ? std::min(cfg.mip_levels, full) : full;
+    texture.levels.assign(levels,
+                          std::vector<std::vector<uint8_t>>(pages.size()));
+    pool.ParallelFor(0, int(pages.size()), 1, [&](int b, int e) {
+      for (int p = b; p < e; ++p) {
+        const uint8_t* page = atlas[p].data();
+        texture.levels[0][p] =
+            sdf::ToTexels(texture.format, page, atlas_w, tex_h, channels);
+        const std::vector<sdf::MipLevel> chain =
+            sdf::BuildSdfMips(page, atlas_w, tex_h, channels,
+                              cfg.radius_px, levels);
+        for (int l = 1; l < levels; ++l) {
+          const sdf::MipLevel& m = chain[l - 1];
+          texture.levels[l][p] = sdf::ToTexels(
+              texture.format, m.texels.data(), m.w, m.h, channels);
+        }
+      }
+    });
+    texture_file = ktx2 ? sdf::Ktx2File(texture) : sdf::DdsFile(texture);
+    writer.Write(writer.Open(texture_name), 0, texture_file);
+  }
+  if (!writer.Finish()) {
+    std::wcerr << L"Writing the atlas failed\n";
+    return -1;
+  }
+  for (size_t p = 0; p < pages.size(); ++p)
+    std::wcout << L"Saved " << image_name(p) << L" (" << atlas_w << L"x"
+               << tex_h << L")\n";
 
-  WriteBmp(L"atlas_super.bmp", kAtlasW, atlas_h, atlas.data());
-  std::wcout << L"Saved atlas_super.bmp (" << kAtlasW << L"x" << atlas_h
-             << L")\n";
-  
   auto end = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> elapsed = end - start;
   std::wcout << L"Elapsed time: " << elapsed.count() << L" seconds\n";
 
-  const int16_t asc = int16_t(kGlyphPX);
-  const int16_t desc = -int16_t(kBorderPX);
-  const int16_t fH = asc - desc;           
-  const uint16_t advY = uint16_t(kGlyphPX + kBorderPX);
-
-  WriteFontAsset("atlas_super",
-                 metas, atlas, uint16_t(kAtlasW), uint16_t(atlas_h), fH, asc,
-                 desc, advY);
-
-  std::wcout << L"Saved atlas_super.sdfb (" << metas.size() << L" glyphs)\n";
+  std::wcout << L"Saved atlas_super.sdfb (" << cps.size() << L" glyphs)\n";
+  if (cfg.container != ContainerFormat::kNone)
+    std::wcout << L"Saved " << texture_name << L" ("
+               << texture.levels.size() << L" mip levels)\n";
   return 0;
 }
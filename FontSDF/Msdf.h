@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "OutlineDistance.h"
+
+namespace sdf {
+
+// Channel mask of an edge: bit 0 red, bit 1 green, bit 2 blue.
+enum EdgeColor : uint8_t {
+  kBlack = 0,
+  kRed = 1,
+  kGreen = 2,
+  kYellow = 3,
+  kBlue = 4,
+  kMagenta = 5,
+  kCyan = 6,
+  kWhite = 7,
+};
+
+inline Vec2 StartDirection(const QuadSegment& s) {
+  Vec2 d{s.c.x - s.p0.x, s.c.y - s.p0.y};
+  if (d.x == 0 && d.y == 0) d = {s.p1.x - s.p0.x, s.p1.y - s.p0.y};
+  return d;
+}
+
+inline Vec2 EndDirection(const QuadSegment& s) {
+  Vec2 d{s.p1.x - s.c.x, s.p1.y - s.c.y};
+  if (d.x == 0 && d.y == 0) d = {s.p1.x - s.p0.x, s.p1.y - s.p0.y};
+  return d;
+}
+
+inline Vec2 DirectionAt(const QuadSegment& s, float t) {
+  Vec2 d{2 * ((1 - t) * (s.c.x - s.p0.x) + t * (s.p1.x - s.c.x)),
+         2 * ((1 - t) * (s.c.y - s.p0.y) + t * (s.p1.y - s.c.y))};
+  if (d.x == 0 && d.y == 0) d = {s.p1.x - s.p0.x, s.p1.y - s.p0.y};
+  return d;
+}
+
+inline float Cross(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+inline float Dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+inline Vec2 Normalize(Vec2 v) {
+  float len = std::sqrt(Dot(v, v));
+  return len > 0 ? Vec2{v.x / len, v.y / len} : Vec2{0, 1};
+}
+
+// Copies g into out with every edge of a contour shorter than three edges
+// split into thirds, as msdfgen does before colouring: a teardrop's lone
+// corner then sits between edges of different colours. Returns false, with
+// out untouched, when no contour is that short.
+inline bool SplitShortContours(const ttf::GlyphContour& g,
+                               ttf::GlyphContour& out) {
+  auto edges = [&](size_t c) {
+    const size_t e =
+        c + 1 == g.contours.size() ? g.segments.size() : g.contours[c + 1];
+    return std::pair{g.contours[c], e};
+  };
+  bool any = false;
+  for (size_t c = 0; c < g.contours.size(); ++c) {
+    const auto [b, e] = edges(c);
+    any |= e > b && e - b < 3;
+  }
+  if (!any) return false;
+  out.segments.clear();
+  out.contours.clear();
+  out.advance_width = g.advance_width;
+  for (size_t c = 0; c < g.contours.size(); ++c) {
+    const auto [b, e] = edges(c);
+    out.contours.push_back(out.segments.size());
+    for (size_t i = b; i < e; ++i) {
+      const ttf::GlyphContour::Segment& s = g.segments[i];
+      if (e - b >= 3) {
+        out.segments.push_back(s);
+        continue;
+      }
+      // The piece over [t0, t1] keeps the curve: its control point is the
+      // blossom of the original at (t0, t1).
+      auto blossom = [&](float t0, float t1, float a, float m, float z) {
+        return (1 - t0) * (1 - t1) * a + ((1 - t0) * t1 + t0 * (1 - t1)) * m +
+               t0 * t1 * z;
+      };
+      for (int k = 0; k < 3; ++k) {
+        const float t0 = k / 3.0f, t1 = (k + 1) / 3.0f;
+        ttf::GlyphContour::Segment piece;
+        piece.x0 = blossom(t0, t0, s.x0, s.cx, s.x1);
+        piece.y0 = blossom(t0, t0, s.y0, s.cy, s.y1);
+        piece.cx = blossom(t0, t1, s.x0, s.cx, s.x1);
+        piece.cy = blossom(t0, t1, s.y0, s.cy, s.y1);
+        piece.x1 = blossom(t1, t1, s.x0, s.cx, s.x1);
+        piece.y1 = blossom(t1, t1, s.y0, s.cy, s.y1);
+        // Pieces share exact endpoints, so no gap opens at a join.
+        if (k > 0) {
+          piece.x0 = out.segments.back().x1;
+          piece.y0 = out.segments.back().y1;
+        }
+        out.segments.push_back(piece);
+      }
+    }
+  }
+  return true;
+}
+
+// msdfgen's "simple" edge colouring. A contour without corners stays white;
+// otherwise the colour switches at every corner, and a single corner splits
+// its contour into three coloured runs so the corner still has two channels
+// disagreeing at it. That needs three edges: contours with fewer go through
+// SplitShortContours first. corners is scratch. cross_threshold is sin() of
+// the largest angle still treated as smooth.
+inline void ColorEdges(const std::vector<QuadSegment>& segs,
+                       const std::vector<size_t>& contours,
+                       std::vector<uint8_t>& colors,
+                       std::vector<size_t>& corners,
+                       float cross_threshold = 0.141f) {
+  colors.assign(segs.size(), kWhite);
+  for (size_t c = 0; c < contours.size(); ++c) {
+    size_t b = contours[c];
+    size_t e = (c + 1 == contours.size()) ? segs.size() : contours[c + 1];
+    if (b == e) continue;
+    const size_t m = e - b;
+
+    corners.clear();
+    for (size_t i = 0; i < m; ++i) {
+      Vec2 a = Normalize(EndDirection(segs[b + (i + m - 1) % m]));
+      Vec2 d = Normalize(StartDirection(segs[b + i]));
+      if (Dot(a, d) <= 0 || std::fabs(Cross(a, d)) > cross_threshold)
+        corners.push_back(i);
+    }
+
+    if (corners.empty()) continue;
+    if (corners.size() == 1) {
+      const uint8_t run[3] = {kMagenta, kWhite, kYellow};
+      for (size_t i = 0; i < m; ++i) {
+        size_t k = (corners[0] + i) % m;
+        colors[b + k] = run[std::min(int(3 * i / m), 2)];
+      }
+      continue;
+    }
+    const uint8_t cycle[3] = {kCyan, kMagenta, kYellow};
+    const size_t start = corners[0];
+    size_t spline = 0;
+    uint8_t color = cycle[0];
+    for (size_t i = 0; i < m; ++i) {
+      size_t k = (start + i) % m;
+      if (i > 0 && std::find(corners.begin(), corners.end(), k) !=
+                       corners.end()) {
+        ++spline;
+        color = cycle[spline % 3];
+        // The last run borders the first one as well.
+        if (spline + 1 == corners.size() && color == cycle[0])
+          color = cycle[(spline + 1) % 3];
+      }
+      colors[b + k] = color;
+    }
+  }
+}
+
+// Multi-channel signed distance field over an OutlineDistanceField. Each
+// channel takes the signed pseudo-distance to the closest edge carrying that
+// channel, so the median of the three reconstructs sharp corners. Distances
+// are in output units and positive inside. Rebuilding keeps the colour
+// buffers.
+class MsdfGenerator {
+ public:
+  void Build(const OutlineDistanceField& field,
+             const std::vector<size_t>& contours) {
+    field_ = &field;
+    ColorEdges(field.Segments(), contours, colors_, corners_);
+
+    // Orientation of the outline in output space: the sign of the total
+    // area tells which side of an edge is inside.
+    double area = 0;
+    for (const auto& s : field.Segments())
+      area += Cross(s.p0, s.p1) / 2.0 +
+              Cross({s.c.x - s.p0.x, s.c.y - s.p0.y},
+                    {s.p1.x - s.p0.x, s.p1.y - s.p0.y}) /
+                  3.0;
+    inside_sign_ = area >= 0 ? 1.0f : -1.0f;
+  }
+
+  // out[0..2] receive the channel distances and out[3] the true signed
+  // distance, all clamped to [-limit, limit].
+  void Evaluate(Vec2 p, float limit, float out[4]) const {
+    struct Best {
+      float dist = FLT_MAX;
+      float ortho = 1;
+      uint32_t idx = UINT32_MAX;
+      float t = 0;
+    } best[3];
+    float true_min = limit;
+    field_->ForEachNear(p, limit, [&](uint32_t idx) {
+      const QuadSegment& s = field_->Segments()[idx];
+      float t;
+      float d = std::sqrt(s.DistanceSq(p, &t));
+      true_min = std::min(true_min, d);
+      Vec2 q = s.Point(t);
+      Vec2 dir = Normalize(DirectionAt(s, t));
+      Vec2 v = Normalize({p.x - q.x, p.y - q.y});
+      float ortho = std::fabs(Dot(dir, v));
+      for (int ch = 0; ch < 3; ++ch) {
+        if (!(colors_[idx] & (1 << ch))) continue;
+        Best& b = best[ch];
+        if (d < b.dist - 1e-6f ||
+            (std::fabs(d - b.dist) <= 1e-6f && ortho < b.ortho))
+          b = {d, ortho, idx, t};
+      }
+    });
+    const bool inside = field_->Winding(p) != 0;
+    const float true_signed = inside ? true_min : -true_min;
+    for (int ch = 0; ch < 3; ++ch)
+      out[ch] = (best[ch].idx == UINT32_MAX)
+                    ? (inside ? limit : -limit)
+                    : std::clamp(PseudoDistance(best[ch].idx, best[ch].t, p),
+                                 -limit, limit);
+    out[3] = true_signed;
+
+    // Error correction: where the median disagrees with the true side the
+    // channels would produce a hole or a spike, so fall back to the plain
+    // distance there.
+    float med = std::max(std::min(out[0], out[1]),
+                         std::min(std::max(out[0], out[1]), out[2]));
+    if ((med > 0) != inside && true_min > 0)
+      out[0] = out[1] = out[2] = true_signed;
+  }
+
+ private:
+  const OutlineDistanceField* field_ = nullptr;
+  std::vector<uint8_t> colors_;
+  std::vector<size_t> corners_;
+  float inside_sign_ = 1;
+
+  // Signed distance to the edge, extended along its end tangents when the
+  // closest point is an endpoint and p lies beyond it.
+  float PseudoDistance(uint32_t idx, float t, Vec2 p) const {
+    const QuadSegment& s = field_->Segments()[idx];
+    Vec2 q = s.Point(t);
+    Vec2 dir = Normalize(DirectionAt(s, t));
+    Vec2 v{p.x - q.x, p.y - q.y};
+    float dist = std::sqrt(Dot(v, v));
+    float side = Cross(dir, v) * inside_sign_ >= 0 ? 1.0f : -1.0f;
+    if (t <= 0 || t >= 1) {
+      Vec2 tangent = Normalize(t <= 0 ? StartDirection(s) : EndDirection(s));
+      Vec2 end = t <= 0 ? s.p0 : s.p1;
+      Vec2 w{p.x - end.x, p.y - end.y};
+      float along = Dot(w, tangent);
+      if ((t <= 0 && along < 0) || (t >= 1 && along > 0)) {
+        float perp = Cross(tangent, w) * inside_sign_;
+        if (std::fabs(perp) <= dist) return perp;
+      }
+    }
+    return side * dist;
+  }
+};
+
+}  // namespace sdf
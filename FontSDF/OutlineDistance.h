@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "FontLoader.h"
+
+namespace sdf {
+
+struct Vec2 {
+  float x, y;
+};
+
+// Real roots of a*t^3 + b*t^2 + c*t + d = 0. Falls back to the quadratic or
+// linear case when the leading coefficients vanish.
+inline int SolveCubic(double a, double b, double c, double d, double out[3]) {
+  constexpr double kEps = 1e-12;
+  if (std::fabs(a) < kEps) {
+    if (std::fabs(b) < kEps) {
+      if (std::fabs(c) < kEps) return 0;
+      out[0] = -d / c;
+      return 1;
+    }
+    double disc = c * c - 4 * b * d;
+    if (disc < 0) return 0;
+    double sq = std::sqrt(disc);
+    out[0] = (-c + sq) / (2 * b);
+    out[1] = (-c - sq) / (2 * b);
+    return 2;
+  }
+  b /= a;
+  c /= a;
+  d /= a;
+  double q = (b * b - 3 * c) / 9;
+  double r = (b * (2 * b * b - 9 * c) + 27 * d) / 54;
+  double q3 = q * q * q;
+  if (r * r < q3) {
+    double th = std::acos(std::clamp(r / std::sqrt(q3), -1.0, 1.0));
+    double m = -2 * std::sqrt(q);
+    constexpr double kTwoPi = 6.283185307179586;
+    out[0] = m * std::cos(th / 3) - b / 3;
+    out[1] = m * std::cos((th + kTwoPi) / 3) - b / 3;
+    out[2] = m * std::cos((th - kTwoPi) / 3) - b / 3;
+    return 3;
+  }
+  double u = -std::cbrt(std::fabs(r) + std::sqrt(r * r - q3));
+  if (r < 0) u = -u;
+  double v = (u == 0) ? 0 : q / u;
+  out[0] = (u + v) - b / 3;
+  return 1;
+}
+
+// Quadratic Bezier p0-c-p1. Lines are stored with c at the midpoint, exactly
+// as FontLoader emits them.
+struct QuadSegment {
+  Vec2 p0, c, p1;
+
+  Vec2 Point(float t) const {
+    float s = 1 - t;
+    return {s * s * p0.x + 2 * s * t * c.x + t * t * p1.x,
+            s * s * p0.y + 2 * s * t * c.y + t * t * p1.y};
+  }
+
+  // Squared distance from p to the closest point of the segment; the
+  // parameter of that point is returned through t_out.
+  float DistanceSq(Vec2 p, float* t_out = nullptr) const {
+    const double ax = c.x - p0.x, ay = c.y - p0.y;
+    const double bx = p1.x - 2 * c.x + p0.x, by = p1.y - 2 * c.y + p0.y;
+    const double mx = p0.x - p.x, my = p0.y - p.y;
+    double roots[3];
+    int n = SolveCubic(bx * bx + by * by, 3 * (ax * bx + ay * by),
+                       2 * (ax * ax + ay * ay) + (mx * bx + my * by),
+                       mx * ax + my * ay, roots);
+    float best_t = 0;
+    float best = Dist2(Point(0), p);
+    float d1 = Dist2(Point(1), p);
+    if (d1 < best) {
+      best = d1;
+      best_t = 1;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (!(roots[i] > 0 && roots[i] < 1)) continue;
+      float t = float(roots[i]);
+      float d = Dist2(Point(t), p);
+      if (d < best) {
+        best = d;
+        best_t = t;
+      }
+    }
+    if (t_out) *t_out = best_t;
+    return best;
+  }
+
+  static float Dist2(Vec2 a, Vec2 b) {
+    float dx = a.x - b.x, dy = a.y - b.y;
+    return dx * dx + dy * dy;
+  }
+};
+
+// Exact signed distance to a glyph outline made of quadratic segments.
+// Segments are bucketed into a uniform grid so a query only visits the cells
+// that can still hold something closer than the best hit; the sign comes
+// from the non-zero winding number, counted over the y-monotonic pieces that
+// share the query's grid row.
+class OutlineDistanceField {
+ public:
+  // Maps font units to the output space as (u * sx + tx, v * sy + ty) and
+  // indexes the region [0, width) x [0, height) with cells of cell_size.
+  // Rebuilding keeps every buffer, so a field reused across glyphs stops
+  // allocating once it has seen the largest one.
+  void Build(const ttf::GlyphContour& g, float sx, float tx, float sy,
+             float ty, int width, int height, float cell_size) {
+    cell_ = cell_size;
+    gw_ = std::max(1, int(std::ceil(width / cell_size)));
+    gh_ = std::max(1, int(std::ceil(height / cell_size)));
+    segments_.clear();
+    pieces_.clear();
+    segments_.reserve(g.segments.size());
+    for (const auto& s : g.segments)
+      segments_.push_back({{s.x0 * sx + tx, s.y0 * sy + ty},
+                           {s.cx * sx + tx, s.cy * sy + ty},
+                           {s.x1 * sx + tx, s.y1 * sy + ty}});
+    for (const auto& s : segments_) SplitMonotonic(s);
+
+    cell_start_.assign(gw_ * gh_ + 1, 0);
+    band_start_.assign(gh_ + 1, 0);
+    ForEachCell([&](uint32_t, int cell) { ++cell_start_[cell + 1]; });
+    ForEachBand([&](uint32_t, int band) { ++band_start_[band + 1]; });
+    for (int i = 0; i < gw_ * gh_; ++i) cell_start_[i + 1] += cell_start_[i];
+    for (int i = 0; i < gh_; ++i) band_start_[i + 1] += band_start_[i];
+    cell_items_.resize(cell_start_.back());
+    band_items_.resize(band_start_.back());
+    fill_.assign(cell_start_.begin(), cell_start_.end() - 1);
+    ForEachCell(
+        [&](uint32_t i, int cell) { cell_items_[fill_[cell]++] = i; });
+    fill_.assign(band_start_.begin(), band_start_.end() - 1);
+    ForEachBand(
+        [&](uint32_t i, int band) { band_items_[fill_[band]++] = i; });
+
+    stamp_.assign(segments_.size(), 0);
+    query_ = 0;
+  }
+
+  bool Empty() const noexcept { return segments_.empty(); }
+
+  // Unsigned distance from p to the outline, or limit if nothing is closer.
+  float Distance(Vec2 p, float limit) const {
+    NextQuery();
+    int ci = std::clamp(int(p.x / cell_), 0, gw_ - 1);
+    int cj = std::clamp(int(p.y / cell_), 0, gh_ - 1);
+    float best2 = limit * limit;
+    const int max_ring = std::max({ci, cj, gw_ - 1 - ci, gh_ - 1 - cj});
+    for (int r = 0; r <= max_ring; ++r) {
+      float lb = (r - 1) * cell_;
+      if (r > 1 && lb * lb >= best2) break;
+      for (int j = cj - r; j <= cj + r; ++j) {
+        if (j < 0 || j >= gh_) continue;
+        bool edge_row = (j == cj - r || j == cj + r);
+        for (int i = ci - r; i <= ci + r; i += edge_row ? 1 : 2 * r) {
+          if (i >= 0 && i < gw_) VisitCell(j * gw_ + i, p, best2);
+          if (r == 0) break;
+        }
+      }
+    }
+    return std::sqrt(best2);
+  }
+
+  // Calls fn(index) once for every segment registered in a cell that lies
+  // within radius of p. Candidates farther than radius may be included.
+  template <typename Fn>
+  void ForEachNear(Vec2 p, float radius, Fn&& fn) const {
+    NextQuery();
+    int i0 = std::clamp(int(std::floor((p.x - radius) / cell_)), 0, gw_ - 1);
+    int i1 = std::clamp(int(std::floor((p.x + radius) / cell_)), 0, gw_ - 1);
+    int j0 = std::clamp(int(std::floor((p.y - radius) / cell_)), 0, gh_ - 1);
+    int j1 = std::clamp(int(std::floor((p.y + radius) / cell_)), 0, gh_ - 1);
+    for (int j = j0; j <= j1; ++j)
+      for (int i = i0; i <= i1; ++i) {
+        int cell = j * gw_ + i;
+        for (uint32_t k = cell_start_[cell]; k < cell_start_[cell + 1]; ++k) {
+          uint32_t idx = cell_items_[k];
+          if (stamp_[idx] == query_) continue;
+          stamp_[idx] = query_;
+          fn(idx);
+        }
+      }
+  }
+
+  // Non-zero winding of the outline around p.
+  int Winding(Vec2 p) const {
+    int band = std::clamp(int(p.y / cell_), 0, gh_ - 1);
+    int wind = 0;
+    for (uint32_t k = band_start_[band]; k < band_start_[band + 1]; ++k) {
+      const QuadSegment& s = pieces_[band_items_[k]];
+      if ((s.p0.y <= p.y) == (s.p1.y <= p.y)) continue;
+      if (CrossingX(s, p.y) > p.x) wind += (s.p1.y > s.p0.y) ? 1 : -1;
+    }
+    return wind;
+  }
+
+  const std::vector<QuadSegment>& Segments() const noexcept {
+    return segments_;
+  }
+
+ private:
+  float cell_ = 1;
+  int gw_ = 1, gh_ = 1;
+  std::vector<QuadSegment> segments_;
+  std::vector<QuadSegment> pieces_;
+  std::vector<uint32_t> cell_start_, cell_items_;
+  std::vector<uint32_t> band_start_, band_items_;
+  std::vector<uint32_t> fill_;
+  mutable std::vector<uint32_t> stamp_;
+  mutable uint32_t query_ = 0;
+
+  void NextQuery() const {
+    if (++query_ != 0) return;
+    std::fill(stamp_.begin(), stamp_.end(), 0);
+    query_ = 1;
+  }
+
+  void SplitMonotonic(const QuadSegment& s) {
+    float den = s.p0.y - 2 * s.c.y + s.p1.y;
+    float t = (den != 0) ? (s.p0.y - s.c.y) / den : -1;
+    if (!(t > 0 && t < 1)) {
+      pieces_.push_back(s);
+      return;
+    }
+    Vec2 q0{s.p0.x + (s.c.x - s.p0.x) * t, s.p0.y + (s.c.y - s.p0.y) * t};
+    Vec2 q1{s.c.x + (s.p1.x - s.c.x) * t, s.c.y + (s.p1.y - s.c.y) * t};
+    Vec2 m = s.Point(t);
+    m.y = q0.y;  // snap the extremum so both halves stay monotonic
+    pieces_.push_back({s.p0, q0, m});
+    pieces_.push_back({m, {q1.x, q0.y}, s.p1});
+  }
+
+  static float CrossingX(const QuadSegment& s, float y) {
+    double a = s.p0.y - 2.0 * s.c.y + s.p1.y;
+    double b = 2.0 * (s.c.y - s.p0.y);
+    double c = s.p0.y - double(y);
+    double t;
+    if (std::fabs(a) < 1e-9) {
+      t = -c / b;
+    } else {
+      double disc = std::max(0.0, b * b - 4 * a * c);
+      double sq = std::sqrt(disc);
+      double q = -0.5 * (b + (b < 0 ? -sq : sq));
+      double t0 = q / a, t1 = (q != 0) ? c / q : t0;
+      t = (t0 >= -1e-6 && t0 <= 1 + 1e-6) ? t0 : t1;
+    }
+    return s.Point(float(std::clamp(t, 0.0, 1.0))).x;
+  }
+
+  template <typename Fn>
+  void ForEachCell(Fn&& fn) const {
+    for (uint32_t i = 0; i < segments_.size(); ++i) {
+      const QuadSegment& s = segments_[i];
+      float x0 = std::min({s.p0.x, s.c.x, s.p1.x});
+      float x1 = std::max({s.p0.x, s.c.x, s.p1.x});
+      float y0 = std::min({s.p0.y, s.c.y, s.p1.y});
+      float y1 = std::max({s.p0.y, s.c.y, s.p1.y});
+      int i0 = std::clamp(int(std::floor(x0 / cell_)), 0, gw_ - 1);
+      int i1 = std::clamp(int(std::floor(x1 / cell_)), 0, gw_ - 1);
+      int j0 = std::clamp(int(std::floor(y0 / cell_)), 0, gh_ - 1);
+      int j1 = std::clamp(int(std::floor(y1 / cell_)), 0, gh_ - 1);
+      for (int j = j0; j <= j1; ++j)
+        for (int k = i0; k <= i1; ++k) fn(i, j * gw_ + k);
+    }
+  }
+
+  template <typename Fn>
+  void ForEachBand(Fn&& fn) const {
+    for (uint32_t i = 0; i < pieces_.size(); ++i) {
+      const QuadSegment& s = pieces_[i];
+      float y0 = std::min(s.p0.y, s.p1.y);
+      float y1 = std::max(s.p0.y, s.p1.y);
+      int j0 = std::clamp(int(std::floor(y0 / cell_)), 0, gh_ - 1);
+      int j1 = std::clamp(int(std::floor(y1 / cell_)), 0, gh_ - 1);
+      for (int j = j0; j <= j1; ++j) fn(i, j);
+    }
+  }
+
+  void VisitCell(int cell, Vec2 p, float& best2) const {
+    for (uint32_t k = cell_start_[cell]; k < cell_start_[cell + 1]; ++k) {
+      uint32_t i = cell_items_[k];
+      if (stamp_[i] == query_) continue;
+      stamp_[i] = query_;
+      best2 = std::min(best2, segments_[i].DistanceSq(p));
+    }
+  }
+};
+
+}  // namespace sdf
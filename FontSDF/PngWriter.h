@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "Crc32.h"
+#include "Deflate.h"
+
+namespace sdf {
+
+// 8-bit PNG written row by row: gray for one channel, RGB for three and RGBA
+// for four. Each row is filtered with Up or Paeth, whichever leaves the
+// smaller residuals; both predict a smooth distance field well. Memory is
+// one previous row plus the compressor's window, whatever the image size.
+class PngEncoder {
+ public:
+  PngEncoder(int w, int h, int channels)
+      : w_(w), h_(h), channels_(channels),
+        prev_(size_t(w) * channels, 0),
+        line_(2, std::vector<uint8_t>(1 + size_t(w) * channels)) {}
+
+  // Signature and IHDR.
+  void Begin(std::vector<uint8_t>& out) {
+    static const uint8_t kSignature[8] = {0x89, 'P',  'N',  'G',
+                                          '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), kSignature, kSignature + 8);
+    uint8_t ihdr[13] = {};
+    Put32(ihdr, uint32_t(w_));
+    Put32(ihdr + 4, uint32_t(h_));
+    ihdr[8] = 8;  // bits per channel
+    ihdr[9] = channels_ == 1 ? 0 : channels_ == 3 ? 2 : 6;
+    Chunk("IHDR", ihdr, sizeof(ihdr), out);
+  }
+
+  // Adds n rows of w * channels bytes; full IDAT chunks are appended to out.
+  void AddRows(const uint8_t* rows, int n, std::vector<uint8_t>& out) {
+    const size_t pitch = size_t(w_) * channels_;
+    for (int r = 0; r < n; ++r, rows += pitch) {
+      const uint8_t* row = rows;
+      const int bpp = channels_;
+      // line_[0]: Up, line_[1]: Paeth.
+      line_[0][0] = 2;
+      line_[1][0] = 4;
+      uint64_t cost[2] = {0, 0};
+      for (size_t i = 0; i < pitch; ++i) {
+        const int a = i >= size_t(bpp) ? row[i - bpp] : 0;
+        const int b = prev_[i];
+        const int c = i >= size_t(bpp) ? prev_[i - bpp] : 0;
+        const uint8_t up = uint8_t(row[i] - b);
+        const uint8_t paeth = uint8_t(row[i] - Paeth(a, b, c));
+        line_[0][1 + i] = up;
+        line_[1][1 + i] = paeth;
+        cost[0] += std::abs(int8_t(up));
+        cost[1] += std::abs(int8_t(paeth));
+      }
+      const std::vector<uint8_t>& best = line_[cost[1] < cost[0] ? 1 : 0];
+      deflate_.Add(best.data(), best.size(), idat_);
+      std::copy(row, row + pitch, prev_.begin());
+      if (idat_.size() >= kIdatBytes) FlushIdat(out);
+    }
+  }
+
+  // After the last row: the rest of the stream and IEND.
+  void End(std::vector<uint8_t>& out) {
+    deflate_.Finish(idat_);
+    FlushIdat(out);
+    Chunk("IEND", nullptr, 0, out);
+  }
+
+ private:
+  static constexpr size_t kIdatBytes = 1 << 16;
+
+  int w_, h_, channels_;
+  std::vector<uint8_t> prev_;               // previous unfiltered row
+  std::vector<std::vector<uint8_t>> line_;  // filter byte + filtered row
+  std::vector<uint8_t> idat_;               // compressed, not yet chunked
+  DeflateEncoder deflate_;
+
+  static int Paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+  }
+
+  static void Put32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+  }
+
+  static void Chunk(const char* type, const uint8_t* data, size_t n,
+                    std::vector<uint8_t>& out) {
+    uint8_t word[4];
+    Put32(word, uint32_t(n));
+    out.insert(out.end(), word, word + 4);
+    const size_t at = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (n) out.insert(out.end(), data, data + n);
+    Put32(word, Crc32(&out[at], out.size() - at));
+    out.insert(out.end(), word, word + 4);
+  }
+
+  void FlushIdat(std::vector<uint8_t>& out) {
+    if (idat_.empty()) return;
+    Chunk("IDAT", idat_.data(), idat_.size(), out);
+    idat_.clear();
+  }
+};
+
+}  // namespace sdf
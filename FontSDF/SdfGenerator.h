@@ -0,0 +1,781 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "BitPlane.h"
+#include "FontLoader.h"
+#include "Msdf.h"
+#include "OutlineDistance.h"
+#include "SimdKernels.h"
+#include "SpiralTable.h"
+#include "TaskPool.h"
+
+namespace sdf {
+
+// kBruteForce scans the (2R+1)^2 hi-res window around every texel and is kept
+// as the reference; kSpiral probes texel cells in distance order, kTiled
+// searches rings of 8 x 8 tiles, kRowSpan binary-searches per-row runs
+// instead of a dense plane and kPyramid answers the same query from an
+// occupancy pyramid, while kExactEdt gives the same distances in linear time.
+// kAnalytic skips the hi-res plane and measures the quadratic outline itself.
+enum class SdfEngine {
+  kBruteForce,
+  kSpiral,
+  kTiled,
+  kRowSpan,
+  kPyramid,
+  kExactEdt,
+  kAnalytic,
+};
+
+// kMsdf / kMtsdf always measure the outline analytically, whatever the engine.
+enum class ChannelLayout { kSdf, kMsdf, kMtsdf };
+
+// Picture of each atlas page written next to the asset. kBmp8 stores
+// single-channel atlases as 8-bit palette indices instead of 24-bit gray.
+enum class ImageFormat { kBmp, kBmp8, kPng };
+
+// Texel encoding of the asset payload. kBc4 stores single-channel atlases as
+// BC4 blocks, half a byte per texel, ready for a GPU upload.
+enum class TextureCompression { kNone, kBc4 };
+
+// GPU texture file written next to the asset with the pages as array layers
+// and a mip chain, uploadable as is.
+enum class ContainerFormat { kNone, kKtx2, kDds };
+
+constexpr int ChannelCount(ChannelLayout l) {
+  return l == ChannelLayout::kSdf ? 1 : l == ChannelLayout::kMsdf ? 3 : 4;
+}
+
+// Generation parameters, overridable by key=value lines in
+// FontSDFSettings.txt after the font path and the character list.
+struct SdfConfig {
+  int supersample = 0;  // hi-res pixels per texel, a multiple of 4; 0 = auto
+  float max_error_em = 1.0f / 1024;  // distance error bound for auto
+  int radius_px = 5;                 // spread in texels
+  int border_px = 4;
+  int glyph_px = 16;
+  int atlas_w = 1024;
+  int atlas_h = 4096;  // page height limit; more glyphs open more pages
+  SdfEngine engine = SdfEngine::kPyramid;
+  ChannelLayout layout = ChannelLayout::kSdf;
+  bool dedup_content = false;  // also merge glyphs whose tiles are identical
+  bool allow_rotate = false;   // let the packer turn glyphs by 90 degrees
+  std::string cache_path = "atlas_super.sdfcache";  // empty = no tile cache
+  ImageFormat image = ImageFormat::kBmp;
+  TextureCompression compress = TextureCompression::kNone;
+  ContainerFormat container = ContainerFormat::kNone;
+  // Levels in the container; 0 = the full chain down to 1 x 1. A shorter
+  // chain is only complete for a sampler whose max level or max LOD is
+  // clamped to mip_levels - 1 (GL_TEXTURE_MAX_LEVEL, maxLod).
+  int mip_levels = 0;
+
+  int Channels() const { return ChannelCount(layout); }
+  // Tile side of a glyph one em square; real tiles follow the glyph's box.
+  int LoSide() const { return glyph_px + 2 * border_px; }
+  int HiSide() const { return LoSide() * supersample; }
+};
+
+// Largest hi-res side of a tile. SdfExactEdt squares distances of up to
+// twice this in int, which stays below 2^31. Tiles follow the glyph's box,
+// so the em square alone does not bound them.
+inline constexpr int kMaxHiSide = 16384;
+
+// Texel rows per band task when one glyph is split across the pool. Bands
+// let a few large glyphs keep every thread busy.
+inline constexpr int kBandRows = 16;
+
+// Smallest power-of-two supersample factor whose sampling error, up to one
+// hi-res pixel diagonal, stays within the tolerance. The tolerance is
+// max_error_em converted to texels, but never tighter than half an output
+// code step (R / 255 texels), below which extra precision is quantized away.
+// At the default bound 16 and 32px glyphs get 64x, 64px 32x and 128px 16x.
+inline int AutoSupersample(const SdfConfig& cfg) {
+  const float tol = std::max(cfg.max_error_em * cfg.glyph_px,
+                             cfg.radius_px / 255.0f);
+  const float need = std::sqrt(2.0f) / tol;
+  int ss = 4;
+  while (ss < 64 && ss < need) ss *= 2;
+  return ss;
+}
+
+inline void FlattenQuadR(float x0, float y0, float cx, float cy, float x1,
+                         float y1, float tol2,
+                         std::vector<std::pair<float, float>>& out) {
+  float mx = (x0 + 2 * cx + x1) * 0.25f;
+  float my = (y0 + 2 * cy + y1) * 0.25f;
+  float lx = (x0 + x1) * 0.5f;
+  float ly = (y0 + y1) * 0.5f;
+  float dx = mx - lx;
+  float dy = my - ly;
+  if (dx * dx + dy * dy <= tol2) {
+    out.emplace_back(x1, y1);
+    return;
+  }
+  float q0x = (x0 + cx) * 0.5f;
+  float q0y = (y0 + cy) * 0.5f;
+  float q1x = (cx + x1) * 0.5f;
+  float q1y = (cy + y1) * 0.5f;
+  float qmx = (q0x + q1x) * 0.5f;
+  float qmy = (q0y + q1y) * 0.5f;
+  FlattenQuadR(x0, y0, q0x, q0y, qmx, qmy, tol2, out);
+  FlattenQuadR(qmx, qmy, q1x, q1y, x1, y1, tol2, out);
+}
+
+// Font units -> hi-res pixels: x * scale + off_x, with y measured upwards from
+// the bottom row of the plane.
+struct GlyphFit {
+  float scale, off_x, off_y;
+};
+
+// A glyph's tile at the atlas scale: w x h texels, border included, with the
+// top-left corner (left, top) texels from the pen origin, y pointing up.
+// Every glyph shares one scale, so relative sizes survive.
+struct GlyphBox {
+  float scale;  // texels per font unit
+  int w, h;
+  int left, top;
+};
+
+inline GlyphBox BoxOf(const ttf::GlyphBounds& b, float scale, int border) {
+  const int x0 = int(std::floor(b.x_min * scale)) - border;
+  const int x1 = int(std::ceil(b.x_max * scale)) + border;
+  const int y0 = int(std::floor(b.y_min * scale)) - border;
+  const int y1 = int(std::ceil(b.y_max * scale)) + border;
+  return {scale, x1 - x0, y1 - y0, x0, y1};
+}
+
+inline GlyphFit FitOutline(const GlyphBox& box, int supersample) {
+  const float k = float(supersample);
+  return {box.scale * k, -box.left * k, (box.h - box.top) * k};
+}
+
+// One polygon edge in font units, kept in contour order so the crossing is
+// computed exactly as before; y_min/y_max drive the active edge table.
+struct RasterEdge {
+  float x0, y0, x1, y1;
+  float y_min, y_max;
+};
+
+// Buffers a glyph task keeps across glyphs. Every worker owns one, so after
+// the largest glyph has been seen a glyph is built without touching the heap.
+// Only the thread running the glyph task uses it: a worker waiting on its
+// bands runs band chunks, never another glyph.
+struct GlyphScratch {
+  ttf::GlyphContour outline;
+  ttf::ParseScratch parse;
+  std::vector<std::pair<float, float>> poly;
+  std::vector<RasterEdge> edges;
+  BitPlane plane;
+  SpanPlane spans;
+  OccupancyPyramid pyramid;
+  TiledBitPlane tiled;
+  OutlineDistanceField field;
+  MsdfGenerator msdf;
+  ttf::GlyphContour split;
+  std::vector<int8_t> far;
+  std::vector<int> sat[2];
+  std::vector<int> col[2];
+  std::vector<uint8_t> sdf;
+};
+
+// Buffers of one band chunk, owned by whichever thread runs the chunk.
+struct BandScratch {
+  std::vector<const RasterEdge*> active;
+  std::vector<float> x_int;
+  std::vector<int> run[2];
+  std::vector<int> s, t, dt[2];
+};
+
+inline GlyphScratch& ThreadGlyphScratch() {
+  thread_local GlyphScratch scratch;
+  return scratch;
+}
+
+inline BandScratch& ThreadBandScratch() {
+  thread_local BandScratch scratch;
+  return scratch;
+}
+
+// Flattens every contour once and returns the non-horizontal edges sorted by
+// descending y_max, the order in which the top-down scan meets them.
+inline void BuildRasterEdges(const ttf::GlyphContour& g,
+                             std::vector<RasterEdge>& edges,
+                             std::vector<std::pair<float, float>>& poly) {
+  const float tol2 = 1.0f / (512.0f * 512.0f);
+  edges.clear();
+  for (size_t c = 0; c < g.contours.size(); ++c) {
+    size_t b = g.contours[c];
+    size_t e =
+        (c + 1 == g.contours.size()) ? g.segments.size() : g.contours[c + 1];
+    poly.clear();
+    for (size_t i = b; i < e; ++i) {
+      const auto& s = g.segments[i];
+      poly.emplace_back(s.x0, s.y0);
+      if (s.cx == (s.x0 + s.x1) * 0.5f && s.cy == (s.y0 + s.y1) * 0.5f)
+        poly.emplace_back(s.x1, s.y1);
+      else
+        FlattenQuadR(s.x0, s.y0, s.cx, s.cy, s.x1, s.y1, tol2, poly);
+    }
+    if (poly.size() < 2) continue;
+    for (size_t i = 0, N = poly.size(); i < N; ++i) {
+      auto [x0, y0] = poly[i];
+      auto [x1, y1] = poly[(i + 1) % N];
+      if (y0 == y1) continue;
+      edges.push_back({x0, y0, x1, y1, std::min(y0, y1), std::max(y0, y1)});
+    }
+  }
+  std::sort(edges.begin(), edges.end(),
+            [](const RasterEdge& a, const RasterEdge& b) {
+              return a.y_max > b.y_max;
+            });
+}
+
+// Even-odd scan conversion of rows [sy_begin, sy_end) of a width x height
+// pixel grid. Every filled run of row sy reaches emit(sy, sx0, sx1), both ends
+// inclusive. Row ranges are independent, so bands can be scanned in parallel.
+template <class Emit>
+void ScanOutline(const std::vector<RasterEdge>& edges,
+                 const GlyphFit& fit, int width, int height,
+                 int sy_begin, int sy_end, Emit&& emit) {
+  const auto [scale, off_x, off_y] = fit;
+
+  // An edge crosses the scanline at py iff y_min <= py < y_max. py only
+  // decreases, so edges enter once y_max > py and leave once y_min > py.
+  BandScratch& bs = ThreadBandScratch();
+  std::vector<const RasterEdge*>& active = bs.active;
+  std::vector<float>& x_int = bs.x_int;
+  active.clear();
+  size_t next = 0;
+  for (int sy = sy_begin; sy < sy_end; ++sy) {
+    float py_unit = (height - 1 - sy + 0.5f - off_y) / scale;
+    while (next < edges.size() && edges[next].y_max > py_unit)
+      active.push_back(&edges[next++]);
+    std::erase_if(active,
+                  [&](const RasterEdge* e) { return e->y_min > py_unit; });
+    if (active.size() < 2) {
+      if (next == edges.size() && active.empty()) break;
+      continue;
+    }
+    x_int.clear();
+    for (const RasterEdge* e : active) {
+      if ((e->y0 > py_unit) != (e->y1 > py_unit)) {
+        float t = (py_unit - e->y0) / (e->y1 - e->y0);
+        x_int.push_back(e->x0 + t * (e->x1 - e->x0));
+      }
+    }
+    if (x_int.size() < 2) continue;
+    std::sort(x_int.begin(), x_int.end());
+    const float eps = 1e-5f;
+    size_t w = 0;
+    for (size_t i = 0; i < x_int.size(); ++i)
+      if (w == 0 || std::fabs(x_int[i] - x_int[w - 1]) > eps)
+        x_int[w++] = x_int[i];
+    x_int.resize(w);
+    for (size_t k = 0; k + 1 < x_int.size(); k += 2) {
+      int sx0 = int(x_int[k] * scale + off_x);
+      int sx1 = int(x_int[k + 1] * scale + off_x);
+      sx0 = std::clamp(sx0, 0, width - 1);
+      sx1 = std::clamp(sx1, 0, width - 1);
+      emit(sy, sx0, sx1);
+    }
+  }
+}
+
+// Hi-res rows per raster band task.
+inline int RasterBandRows(const SdfConfig& cfg) {
+  return kBandRows * cfg.supersample;
+}
+
+// Bands write disjoint rows of the plane, so they run on the pool.
+inline void RasterOutline(const ttf::GlyphContour& g, const GlyphBox& box,
+                          const SdfConfig& cfg, TaskPool& pool,
+                          GlyphScratch& gs, BitPlane& bmp) {
+  if (g.segments.empty()) return;
+  const GlyphFit fit = FitOutline(box, cfg.supersample);
+  BuildRasterEdges(g, gs.edges, gs.poly);
+  pool.ParallelFor(0, bmp.h, RasterBandRows(cfg), [&](int b, int e) {
+    ScanOutline(gs.edges, fit, bmp.w, bmp.h, b, e, [&](int sy, int x0, int x1) {
+      bmp.FillSpan(sy, x0, x1);
+    });
+  });
+}
+
+// SpanPlane is appended row by row, so this one stays serial.
+inline void RasterOutline(const ttf::GlyphContour& g, const GlyphBox& box,
+                          const SdfConfig& cfg, GlyphScratch& gs,
+                          SpanPlane& spans) {
+  if (!g.segments.empty()) {
+    const GlyphFit fit = FitOutline(box, cfg.supersample);
+    BuildRasterEdges(g, gs.edges, gs.poly);
+    ScanOutline(gs.edges, fit, spans.w, spans.h, 0, spans.h,
+                [&](int sy, int x0, int x1) { spans.AddSpan(sy, x0, x1); });
+  }
+  spans.Finish();
+}
+
+// Supersample and radius as the distance kernels see them. FixedParams bakes
+// a combination into the instantiation so the inner loops work on constants;
+// RuntimeParams carries any other combination.
+template <int SS, int RadiusPX>
+struct FixedParams {
+  static constexpr int ss = SS;
+  static constexpr int R = SS * RadiusPX;
+};
+
+struct RuntimeParams {
+  int ss;
+  int R;
+};
+
+template <class Fn, int SS, int... Radii>
+bool DispatchRadius(int radius_px, Fn& fn,
+                    std::integer_sequence<int, Radii...>) {
+  return ((radius_px == Radii && (fn(FixedParams<SS, Radii>{}), true)) || ...);
+}
+
+// Calls fn with FixedParams for the common supersample x spread combinations
+// (the factors AutoSupersample picks for 16..128px glyphs) and with
+// RuntimeParams for everything else.
+template <class Fn>
+void WithKernelParams(const SdfConfig& cfg, Fn&& fn) {
+  using Spreads = std::integer_sequence<int, 4, 5, 6, 7, 8>;
+  bool fixed = false;
+  switch (cfg.supersample) {
+    case 16:
+      fixed = DispatchRadius<Fn, 16>(cfg.radius_px, fn, Spreads{});
+      break;
+    case 32:
+      fixed = DispatchRadius<Fn, 32>(cfg.radius_px, fn, Spreads{});
+      break;
+    case 64:
+      fixed = DispatchRadius<Fn, 64>(cfg.radius_px, fn, Spreads{});
+      break;
+  }
+  if (!fixed)
+    fn(RuntimeParams{cfg.supersample, cfg.radius_px * cfg.supersample});
+}
+
+template <class P, class Plane>
+bool SampleInside(const P& p, const Plane& hi, int x, int y) {
+  const int step = p.ss / 4;
+  const int half = step >> 1;
+  int in_cnt = 0;
+  for (int sy = 0; sy < 4; ++sy)
+    for (int sx = 0; sx < 4; ++sx) {
+      int hx = x * p.ss + sx * step + half;
+      int hy = y * p.ss + sy * step + half;
+      in_cnt += hi.GetUnchecked(hx, hy);
+    }
+  return in_cnt >= 8;
+}
+
+inline uint8_t EncodeNorm(float signed_n) {
+  return uint8_t(std::clamp(128.0f + signed_n * 127.0f, 0.0f, 255.0f));
+}
+
+template <class P>
+uint8_t EncodeDistance(const P& p, int best, bool inside) {
+  float norm = std::sqrt(float(best)) / float(p.R);
+  return EncodeNorm(inside ? norm : -norm);
+}
+
+// Coarse pass for the search kernels. Each texel's SS x SS footprint is
+// classified as all clear, all set or mixed, and a summed-area table over
+// those states tells whether a texel's whole (2R+1)^2 search window is one
+// colour. Such a texel has no opposite pixel within R, so its value is the
+// clamped one and the search can be skipped. far[i] is 0 / 1 for a texel
+// saturated outside / inside and -1 for one inside the band.
+template <class P, class Plane>
+void ClassifyBand(const P& p, const Plane& hi, int lo_w, int lo_h,
+                  GlyphScratch& gs) {
+  const int SS = p.ss, R = p.R;
+  const int n = lo_w + 1;
+  std::vector<int>& sat_clear = gs.sat[0];
+  std::vector<int>& sat_set = gs.sat[1];
+  sat_clear.assign(n * (lo_h + 1), 0);
+  sat_set.assign(n * (lo_h + 1), 0);
+  for (int by = 0; by < lo_h; ++by)
+    for (int bx = 0; bx < lo_w; ++bx) {
+      int st = hi.RectState(bx * SS, by * SS, bx * SS + SS - 1,
+                            by * SS + SS - 1);
+      int i = (by + 1) * n + bx + 1;
+      sat_clear[i] = (st == 0) + sat_clear[i - 1] + sat_clear[i - n] -
+                     sat_clear[i - n - 1];
+      sat_set[i] =
+          (st == 1) + sat_set[i - 1] + sat_set[i - n] - sat_set[i - n - 1];
+    }
+  auto sum = [&](const std::vector<int>& t, int x0, int y0, int x1, int y1) {
+    return t[(y1 + 1) * n + x1 + 1] - t[y0 * n + x1 + 1] -
+           t[(y1 + 1) * n + x0] + t[y0 * n + x0];
+  };
+
+  std::vector<int8_t>& far = gs.far;
+  far.assign(lo_w * lo_h, -1);
+  for (int y = 0; y < lo_h; ++y)
+    for (int x = 0; x < lo_w; ++x) {
+      int cx = x * SS + SS / 2;
+      int cy = y * SS + SS / 2;
+      // Block range of the window; blocks off the plane read as clear.
+      int bx0 = (cx - R) >= 0 ? (cx - R) / SS : -1;
+      int by0 = (cy - R) >= 0 ? (cy - R) / SS : -1;
+      int bx1 = (cx + R) / SS, by1 = (cy + R) / SS;
+      int total = (bx1 - bx0 + 1) * (by1 - by0 + 1);
+      int ix0 = std::max(bx0, 0), iy0 = std::max(by0, 0);
+      int ix1 = std::min(bx1, lo_w - 1), iy1 = std::min(by1, lo_h - 1);
+      int inner = (ix1 - ix0 + 1) * (iy1 - iy0 + 1);
+      int clear = sum(sat_clear, ix0, iy0, ix1, iy1) + (total - inner);
+      if (clear == total)
+        far[y * lo_w + x] = 0;
+      else if (inner == total && sum(sat_set, ix0, iy0, ix1, iy1) == total)
+        far[y * lo_w + x] = 1;
+    }
+}
+
+// Shared driver of the search engines: texels outside the band take the
+// clamped value, the rest ask nearest(cx, cy, value, limit) for the squared
+// distance to the closest hi-res pixel equal to value, capped at R^2.
+// Row bands run on the pool, so nearest must be safe to call concurrently.
+template <class P, class Plane, class Nearest>
+void SdfSearch(const P& p, TaskPool& pool, GlyphScratch& gs,
+               const Plane& hi, int lo_w, int lo_h,
+               std::vector<uint8_t>& sdf, Nearest&& nearest) {
+  const int R2 = p.R * p.R;
+  ClassifyBand(p, hi, lo_w, lo_h, gs);
+  const std::vector<int8_t>& far = gs.far;
+  pool.ParallelFor(0, lo_h, kBandRows, [&](int y0, int y1) {
+    for (int y = y0; y < y1; ++y)
+      for (int x = 0; x < lo_w; ++x) {
+        const int8_t f = far[y * lo_w + x];
+        if (f >= 0) {
+          sdf[y * lo_w + x] = EncodeDistance(p, R2, f != 0);
+          continue;
+        }
+        bool inside = SampleInside(p, hi, x, y);
+        int cx = x * p.ss + p.ss / 2;
+        int cy = y * p.ss + p.ss / 2;
+        int best = nearest(cx, cy, !inside, R2);
+        sdf[y * lo_w + x] = EncodeDistance(p, best, inside);
+      }
+  });
+}
+
+template <class P>
+void SdfBruteForce(const P& p, TaskPool& pool,
+                   GlyphScratch& gs, const BitPlane& hi, int lo_w,
+                   int lo_h, std::vector<uint8_t>& sdf) {
+  const int R = p.R;
+  const DistanceKernels& kern = Kernels();
+  // Rows are taken by increasing |dy| in blocks of 16. The SIMD kernels scan
+  // the words of several rows at once for the closest opposite pixel each
+  // way, then fold the block into best, stopping once no remaining row can
+  // beat it. Rows off the plane read as clear.
+  auto nearest = [&](int cx, int cy, bool value, int best) {
+    constexpr int kBlock = 16;
+    const uint64_t* rows[kBlock];
+    int32_t dx_buf[kBlock], dy2_buf[kBlock];
+    for (int k = 0; k <= 2 * R;) {
+      int n = 0;
+      for (; n < kBlock && k <= 2 * R; ++k) {
+        int dy = ((k + 1) >> 1) * ((k & 1) ? -1 : 1);
+        if (dy * dy >= best) {
+          k = 2 * R + 1;
+          break;
+        }
+        if (cy + dy < 0 || cy + dy >= hi.h) {
+          if (!value) best = dy * dy;
+          continue;
+        }
+        rows[n] = hi.Row(cy + dy);
+        dy2_buf[n] = dy * dy;
+        ++n;
+      }
+      kern.row_nearest(rows, n, hi.pitch, hi.w, cx, value, R, dx_buf);
+      best = kern.min_dist_sq(dx_buf, dy2_buf, n, best);
+    }
+    return best;
+  };
+  SdfSearch(p, pool, gs, hi, lo_w, lo_h, sdf, nearest);
+}
+
+// Texel cells are probed nearest first and each query stops once the next
+// cell cannot beat its best hit; uniform cells cost one lookup. The table
+// for the default parameters is generated at compile time; others are built
+// once per thread.
+template <class P>
+void SdfSpiral(const P& p, TaskPool& pool,
+               GlyphScratch& gs, const BitPlane& hi, int lo_w,
+               int lo_h, std::vector<uint8_t>& sdf) {
+  std::span<const SpiralCell> table;
+  if constexpr (std::is_same_v<P, FixedParams<64, 5>>) {
+    table = kSpiral<P::ss, P::R>;
+  } else {
+    thread_local std::pair<int, int> key;
+    thread_local std::vector<SpiralCell> cache;
+    if (key != std::pair{p.ss, p.R}) {
+      key = {p.ss, p.R};
+      cache = BuildSpiral(p.ss, p.R);
+    }
+    table = cache;
+  }
+  // Cell states come back out of the summed-area tables ClassifyBand fills.
+  const int n = lo_w + 1;
+  auto state = [&](int tx, int ty) {
+    if (tx < 0 || ty < 0 || tx >= lo_w || ty >= lo_h) return 0;
+    const int i = (ty + 1) * n + tx + 1;
+    auto one = [&](const std::vector<int>& t) {
+      return t[i] - t[i - 1] - t[i - n] + t[i - n - 1];
+    };
+    return one(gs.sat[0]) ? 0 : one(gs.sat[1]) ? 1 : 2;
+  };
+  SdfSearch(p, pool, gs, hi, lo_w, lo_h, sdf,
+            [&](int cx, int cy, bool value, int limit) {
+              return SpiralNearestSq(hi, table, p.ss, cx, cy, value, limit,
+                                     state);
+            });
+}
+
+// Searched over the 8 x 8 tiled copy of the plane.
+template <class P>
+void SdfTiled(const P& p, TaskPool& pool,
+              GlyphScratch& gs, const BitPlane& hi, int lo_w,
+              int lo_h, std::vector<uint8_t>& sdf) {
+  TiledBitPlane& tiled = gs.tiled;
+  tiled.Build(hi);
+  SdfSearch(p, pool, gs, hi, lo_w, lo_h, sdf,
+            [&](int cx, int cy, bool value, int limit) {
+              return tiled.NearestSq(cx, cy, value, limit);
+            });
+}
+
+// From the scanline runs alone: the nearest opposite pixel of a row is one
+// binary search away, and no hi-res plane is ever allocated.
+template <class P>
+void SdfRowSpan(const P& p, TaskPool& pool, GlyphScratch& gs,
+                const SpanPlane& hi, int lo_w, int lo_h,
+                std::vector<uint8_t>& sdf) {
+  SdfSearch(p, pool, gs, hi, lo_w, lo_h, sdf,
+            [&](int cx, int cy, bool value, int limit) {
+              return hi.NearestSq(cx, cy, value, limit);
+            });
+}
+
+// Each query descends an occupancy pyramid so whole uniform 64 x 64 blocks
+// are skipped or answered at once and only the mixed blocks along the
+// outline are scanned.
+template <class P>
+void SdfPyramid(const P& p, TaskPool& pool,
+                GlyphScratch& gs, const BitPlane& hi, int lo_w,
+                int lo_h, std::vector<uint8_t>& sdf) {
+  const OccupancyPyramid& pyr = gs.pyramid;
+  gs.pyramid.Build(hi);
+  SdfSearch(p, pool, gs, hi, lo_w, lo_h, sdf,
+            [&](int cx, int cy, bool value, int limit) {
+              return pyr.NearestSq(hi, cx, cy, value, limit);
+            });
+}
+
+// Lower envelope of the parabolas (x - i)^2 + g[i]^2 evaluated at every x
+// (Meijster, Roerdink, Hesselink 2000). Integer arithmetic, so the result is
+// exact.
+inline void EdtRow(const int* g, int n, int* s, int* t, int* dt) {
+  auto f = [&](int x, int i) { return (x - i) * (x - i) + g[i] * g[i]; };
+  auto sep = [&](int i, int u) {
+    int num = (u * u - i * i) + (g[u] * g[u] - g[i] * g[i]);
+    int den = 2 * (u - i);
+    return num >= 0 ? num / den : -((-num + den - 1) / den);
+  };
+  int q = 0;
+  s[0] = 0;
+  t[0] = 0;
+  for (int u = 1; u < n; ++u) {
+    while (q >= 0 && f(t[q], s[q]) > f(t[q], u)) --q;
+    if (q < 0) {
+      q = 0;
+      s[0] = u;
+    } else {
+      int w = 1 + sep(s[q], u);
+      if (w < n) {
+        ++q;
+        s[q] = u;
+        t[q] = w;
+      }
+    }
+  }
+  for (int u = n - 1; u >= 0; --u) {
+    dt[u] = f(u, s[q]);
+    if (u == t[q]) --q;
+  }
+}
+
+// Separable exact EDT over the hi-res plane. The column pass sweeps the plane
+// in row order and keeps only the texel-centre rows; the row pass then runs
+// on those rows alone. Pixels outside the plane read as clear, exactly like
+// BitPlane::Get, so the result equals SdfBruteForce. The column pass splits
+// into word-aligned column strips and the row pass into bands of centre rows.
+template <class P>
+void SdfExactEdt(const P& p, TaskPool& pool,
+                 GlyphScratch& gs, const BitPlane& hi, int lo_w,
+                 int lo_h, std::vector<uint8_t>& sdf) {
+  const int SS = p.ss;
+  const int R2 = p.R * p.R;
+  const int w = hi.w;
+  const int n = w + 2;  // one virtual clear column on each side
+  const int inf = hi.w + hi.h;
+  const DistanceKernels& kern = Kernels();
+
+  // col[c][k * n + 1 + x]: vertical distance from (x, centre row k) to the
+  // nearest pixel whose value is c.
+  std::vector<int>* col = gs.col;
+  for (int c = 0; c < 2; ++c) col[c].assign(lo_h * n, inf);
+  const int strip = 4 * 64;  // columns per strip, whole words
+  pool.ParallelFor(0, w, strip, [&](int x0, int x1) {
+    const int sw = x1 - x0;
+    std::vector<int>* run = ThreadBandScratch().run;
+    for (int dir = 0; dir < 2; ++dir) {
+      run[0].assign(sw, 0);  // the row beyond the edge is clear
+      run[1].assign(sw, inf);
+      for (int i = 0; i < hi.h; ++i) {
+        int sy = dir == 0 ? i : hi.h - 1 - i;
+        kern.sweep_row(hi.Row(sy) + (x0 >> 6), sw, run[0].data(),
+                       run[1].data());
+        int k = sy / SS;
+        if (sy % SS != SS / 2 || k >= lo_h) continue;
+        for (int c = 0; c < 2; ++c) {
+          int* dst = &col[c][k * n + 1 + x0];
+          for (int x = 0; x < sw; ++x) dst[x] = std::min(dst[x], run[c][x]);
+        }
+      }
+    }
+  });
+
+  pool.ParallelFor(0, lo_h, kBandRows, [&](int k0, int k1) {
+    BandScratch& bs = ThreadBandScratch();
+    std::vector<int>* dt = bs.dt;
+    bs.s.resize(n);
+    bs.t.resize(n);
+    for (int c = 0; c < 2; ++c) dt[c].resize(n);
+    for (int k = k0; k < k1; ++k) {
+      for (int c = 0; c < 2; ++c) {
+        int* g = &col[c][k * n];
+        g[0] = g[n - 1] = (c == 0) ? 0 : inf;
+        EdtRow(g, n, bs.s.data(), bs.t.data(), dt[c].data());
+      }
+      for (int x = 0; x < lo_w; ++x) {
+        bool inside = SampleInside(p, hi, x, k);
+        int cx = x * SS + SS / 2;
+        int best = std::min(dt[inside ? 0 : 1][1 + cx], R2);
+        sdf[k * lo_w + x] = EncodeDistance(p, best, inside);
+      }
+    }
+  });
+}
+
+// Distances are measured from the texel centres straight to the outline in
+// texel units, with y pointing down from the top of the tile.
+inline void SdfAnalytic(const ttf::GlyphContour& g, const GlyphBox& box,
+                        const SdfConfig& cfg, GlyphScratch& gs,
+                        std::vector<uint8_t>& sdf) {
+  const int lo_w = box.w, lo_h = box.h;
+  OutlineDistanceField& field = gs.field;
+  field.Build(g, box.scale, float(-box.left), -box.scale, float(box.top),
+              lo_w, lo_h, 2.0f);
+  const float limit = float(cfg.radius_px);
+  for (int y = 0; y < lo_h; ++y)
+    for (int x = 0; x < lo_w; ++x) {
+      uint8_t v = EncodeNorm(-1.0f);
+      if (!field.Empty()) {
+        Vec2 p{x + 0.5f, y + 0.5f};
+        bool inside = field.Winding(p) != 0;
+        float norm = field.Distance(p, limit) / limit;
+        v = EncodeNorm(inside ? norm : -norm);
+      }
+      sdf[y * lo_w + x] = v;
+    }
+}
+
+// cfg.Channels() bytes per texel: median-of-three channels, then the true
+// distance for kMtsdf.
+inline void SdfMultiChannel(const ttf::GlyphContour& g, const GlyphBox& box,
+                            const SdfConfig& cfg, GlyphScratch& gs,
+                            std::vector<uint8_t>& sdf) {
+  const int lo_w = box.w, lo_h = box.h;
+  const int channels = cfg.Channels();
+  OutlineDistanceField& field = gs.field;
+  MsdfGenerator& msdf = gs.msdf;
+  const ttf::GlyphContour& outline =
+      SplitShortContours(g, gs.split) ? gs.split : g;
+  field.Build(outline, box.scale, float(-box.left), -box.scale,
+              float(box.top), lo_w, lo_h, 2.0f);
+  msdf.Build(field, outline.contours);
+  const float limit = float(cfg.radius_px);
+  for (int y = 0; y < lo_h; ++y)
+    for (int x = 0; x < lo_w; ++x) {
+      float d[4] = {-limit, -limit, -limit, -limit};
+      if (!field.Empty()) msdf.Evaluate({x + 0.5f, y + 0.5f}, limit, d);
+      uint8_t* px = &sdf[(y * lo_w + x) * channels];
+      for (int c = 0; c < channels; ++c) px[c] = EncodeNorm(d[c] / limit);
+    }
+}
+
+// Curve flattening tolerance in font units for outlines fed to GenerateSdf,
+// a sixteenth of a texel.
+inline float OutlineFlatness(const ttf::FontLoader& font,
+                             const SdfConfig& cfg) {
+  return font.UnitsPerEm() / float(cfg.glyph_px * 16);
+}
+
+// One glyph through the engine cfg selects; sdf receives box.w x box.h
+// texels of cfg.Channels() bytes.
+inline void GenerateSdf(const ttf::GlyphContour& outline, const GlyphBox& box,
+                        const SdfConfig& cfg, TaskPool& pool,
+                        GlyphScratch& gs, std::vector<uint8_t>& sdf) {
+  const int lo_w = box.w, lo_h = box.h;
+  if (cfg.layout != ChannelLayout::kSdf) {
+    SdfMultiChannel(outline, box, cfg, gs, sdf);
+    return;
+  }
+  if (cfg.engine == SdfEngine::kAnalytic) {
+    SdfAnalytic(outline, box, cfg, gs, sdf);
+    return;
+  }
+  WithKernelParams(cfg, [&](const auto& p) {
+    const int hi_w = lo_w * p.ss, hi_h = lo_h * p.ss;
+    if (cfg.engine == SdfEngine::kRowSpan) {
+      SpanPlane& hi = gs.spans;
+      hi.Reset(hi_w, hi_h);
+      RasterOutline(outline, box, cfg, gs, hi);
+      SdfRowSpan(p, pool, gs, hi, lo_w, lo_h, sdf);
+      return;
+    }
+    BitPlane& hi = gs.plane;
+    hi.Reset(hi_w, hi_h);
+    RasterOutline(outline, box, cfg, pool, gs, hi);
+    switch (cfg.engine) {
+      case SdfEngine::kBruteForce:
+        SdfBruteForce(p, pool, gs, hi, lo_w, lo_h, sdf);
+        break;
+      case SdfEngine::kSpiral:
+        SdfSpiral(p, pool, gs, hi, lo_w, lo_h, sdf);
+        break;
+      case SdfEngine::kTiled:
+        SdfTiled(p, pool, gs, hi, lo_w, lo_h, sdf);
+        break;
+      case SdfEngine::kPyramid:
+        SdfPyramid(p, pool, gs, hi, lo_w, lo_h, sdf);
+        break;
+      default:
+        SdfExactEdt(p, pool, gs, hi, lo_w, lo_h, sdf);
+        break;
+    }
+  });
+}
+
+}  // namespace sdf
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "SdfGenerator.h"
+
+namespace sdf {
+
+// Mip levels of a distance field atlas. Averaging the encoded bytes does not
+// work: texels saturated at the spread have lost their distance, so a 2 x 2
+// box pulls the outer part of every cell towards the edge, and the ramp
+// keeps its level 0 width, radius / 2^k texels on level k. Each page is
+// decoded into signed distances instead. Saturated texels take the nearest
+// band texel's distance plus the way there, which holds to a fraction of a
+// texel because the band reaches radius texels out from the outline. Every
+// level then samples that field at its own texel centres, as a field
+// generated at that size would, rather than averaging it, which rounds off
+// the ridges inside and between shapes a little more on each level. Levels
+// are encoded with the spread counted in their own texels: a byte decodes
+// to the same multiple of the local texel size on every level, so one
+// shader constant still serves the whole chain. The chain runs down to
+// 1 x 1; once a level's texels outgrow the glyph border, neighbouring glyphs
+// share texels and the level holds the distance to the nearest of them.
+struct MipLevel {
+  int w = 0, h = 0;
+  std::vector<uint8_t> texels;  // w x h texels of `channels` bytes
+};
+
+namespace mips {
+
+// Signed distance in texels of a byte from EncodeNorm, taken at the middle
+// of the range that truncates to it. 1 and 255 are the clamped ends.
+inline float DecodeDistance(uint8_t v, float radius) {
+  return (v + 0.5f - 128.0f) / 127.0f * radius;
+}
+inline bool Saturated(uint8_t v) { return v <= 1 || v == 255; }
+
+// Channel c of a page as signed distances in texels, inside positive, with
+// the band texel each saturated texel was measured from.
+struct Field {
+  int w = 0, h = 0;
+  std::vector<float> d;
+  std::vector<int> seed;  // band texel index, -1 on a page without a band
+  std::vector<uint8_t> far;  // 1 where the page texel is saturated
+};
+
+// Band texels decode directly. The rest are filled by two raster sweeps
+// that hand each texel the neighbour's best band texel s when
+// |x - s| + |d(s)| beats its own, as in Danielsson's vector EDT; they never
+// go below the spread. A page without a band holds no outline at all.
+inline Field DecodeField(const uint8_t* page, int w, int h, int channels,
+                         int c, int radius_px) {
+  const float radius = float(radius_px);
+  const size_t n = size_t(w) * h;
+  Field f;
+  f.w = w;
+  f.h = h;
+  f.d.resize(n);
+  f.seed.assign(n, -1);
+  f.far.resize(n);
+  std::vector<float> cost(n, 0.0f);
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t v = page[i * channels + c];
+    f.d[i] = DecodeDistance(v, radius);
+    f.far[i] = Saturated(v);
+    if (!f.far[i]) {
+      f.seed[i] = int(i);
+      cost[i] = std::fabs(f.d[i]);
+    }
+  }
+  auto offer = [&](int x, int y, int nx, int ny) {
+    if (nx < 0 || nx >= w || ny < 0 || ny >= h) return;
+    const int s = f.seed[size_t(ny) * w + nx];
+    if (s < 0) return;
+    const size_t i = size_t(y) * w + x;
+    const float dx = float(x - s % w), dy = float(y - s / w);
+    const float via = std::sqrt(dx * dx + dy * dy) + std::fabs(f.d[s]);
+    if (f.seed[i] < 0 || via < cost[i]) {
+      f.seed[i] = s;
+      cost[i] = via;
+    }
+  };
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      offer(x, y, x - 1, y);
+      offer(x, y, x - 1, y - 1);
+      offer(x, y, x, y - 1);
+      offer(x, y, x + 1, y - 1);
+    }
+    for (int x = w - 1; x >= 0; --x) offer(x, y, x + 1, y);
+  }
+  for (int y = h - 1; y >= 0; --y) {
+    for (int x = w - 1; x >= 0; --x) {
+      offer(x, y, x + 1, y);
+      offer(x, y, x + 1, y + 1);
+      offer(x, y, x, y + 1);
+      offer(x, y, x - 1, y + 1);
+    }
+    for (int x = 0; x < w; ++x) offer(x, y, x - 1, y);
+  }
+  const float none = radius + float(w + h);
+  for (size_t i = 0; i < n; ++i) {
+    if (!f.far[i]) continue;
+    const float far = f.seed[i] < 0 ? none : std::max(radius, cost[i]);
+    f.d[i] = f.d[i] > 0 ? far : -far;
+  }
+  return f;
+}
+
+// The field at (fx, fy) in texels, texel centres at + 0.5, clamped to the
+// page. Near the outline the four surrounding texels are interpolated
+// bilinearly. Between four saturated texels that would flatten the ridges
+// where the distance peaks, so the point is measured from their band texels
+// the way the sweeps measured the texels themselves.
+inline float Sample(const Field& f, float fx, float fy) {
+  fx = std::clamp(fx - 0.5f, 0.0f, float(f.w - 1));
+  fy = std::clamp(fy - 0.5f, 0.0f, float(f.h - 1));
+  const int x0 = std::min(int(fx), std::max(0, f.w - 2));
+  const int y0 = std::min(int(fy), std::max(0, f.h - 2));
+  const int x1 = std::min(x0 + 1, f.w - 1), y1 = std::min(y0 + 1, f.h - 1);
+  const size_t corner[4] = {size_t(y0) * f.w + x0, size_t(y0) * f.w + x1,
+                            size_t(y1) * f.w + x0, size_t(y1) * f.w + x1};
+  bool far = true, inside = true, outside = true;
+  for (size_t i : corner) {
+    far = far && f.far[i] && f.seed[i] >= 0;
+    inside = inside && f.d[i] > 0;
+    outside = outside && f.d[i] < 0;
+  }
+  if (far && (inside || outside)) {
+    float best = std::numeric_limits<float>::max();
+    for (size_t i : corner) {
+      const int s = f.seed[i];
+      const float dx = fx - float(s % f.w), dy = fy - float(s / f.w);
+      best = std::min(best, std::sqrt(dx * dx + dy * dy) + std::fabs(f.d[s]));
+    }
+    return inside ? best : -best;
+  }
+  const float tx = fx - x0, ty = fy - y0;
+  auto at = [&](int i) { return f.d[corner[i]]; };
+  const float top = at(0) + (at(1) - at(0)) * tx;
+  const float bottom = at(2) + (at(3) - at(2)) * tx;
+  return top + (bottom - top) * ty;
+}
+
+}  // namespace mips
+
+// Levels down to 1 x 1.
+inline int FullMipLevels(int w, int h) {
+  int n = 1;
+  while ((std::max(w, h) >> n) > 0) ++n;
+  return n;
+}
+
+// Levels 1 .. levels - 1 below a w x h page whose texels carry a spread of
+// radius_px. Level k carries radius_px of its own texels, radius_px * 2^k
+// level 0 texels, so its ramp is as many texels wide as level 0's.
+inline std::vector<MipLevel> BuildSdfMips(const uint8_t* page, int w, int h,
+                                          int channels, int radius_px,
+                                          int levels) {
+  std::vector<MipLevel> chain(std::max(0, levels - 1));
+  for (int k = 1; k < levels; ++k) {
+    MipLevel& m = chain[k - 1];
+    m.w = std::max(1, w >> k);
+    m.h = std::max(1, h >> k);
+    m.texels.resize(size_t(m.w) * m.h * channels);
+  }
+  for (int c = 0; c < channels; ++c) {
+    const mips::Field field =
+        mips::DecodeField(page, w, h, channels, c, radius_px);
+    for (int k = 1; k < levels; ++k) {
+      MipLevel& m = chain[k - 1];
+      // Level texel centres in level 0 texels; odd sizes stretch a little.
+      const float sx = float(w) / m.w, sy = float(h) / m.h;
+      const float spread = float(radius_px) * float(1 << k);
+      for (int y = 0; y < m.h; ++y)
+        for (int x = 0; x < m.w; ++x) {
+          const float d =
+              mips::Sample(field, (x + 0.5f) * sx, (y + 0.5f) * sy);
+          m.texels[(size_t(y) * m.w + x) * channels + c] =
+              EncodeNorm(std::clamp(d / spread, -1.0f, 1.0f));
+        }
+    }
+  }
+  return chain;
+}
+
+}  // namespace sdf
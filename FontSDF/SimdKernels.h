@@ -0,0 +1,571 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define SDF_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SDF_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles any intrinsic without flags; GCC and Clang need the target
+// enabled per function so the rest of the file stays baseline x86-64.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SDF_TARGET(isa)
+#else
+#define SDF_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace sdf {
+
+// Integer distance kernels shared by the search and EDT engines. Every
+// variant does the same integer arithmetic, so results match the scalar
+// reference bit for bit.
+struct DistanceKernels {
+  const char* name;
+  // dx[i] = distance from column cx to the nearest pixel equal to value in
+  // rows[i], or limit + 1 when none is within limit. Rows are w pixels in
+  // pitch words, padding clear, and pixels past either end read as clear.
+  // Rows are searched a word at a time, several rows per instruction.
+  void (*row_nearest)(const uint64_t* const* rows, int n, int pitch, int w,
+                      int cx, bool value, int limit, int32_t* dx);
+  // min(best, dx[i]^2 + dy2[i]) over n rows.
+  int (*min_dist_sq)(const int32_t* dx, const int32_t* dy2, int n, int best);
+  // One row of the EDT column sweep: run_set[x] counts rows since the last
+  // set pixel in column x and run_clear[x] since the last clear one.
+  void (*sweep_row)(const uint64_t* row, int w, int32_t* run_clear,
+                    int32_t* run_set);
+};
+
+namespace kernels {
+
+// Word range a row search covers: columns [cx - limit, cx + limit].
+struct RowWords {
+  int wi, b;           // word and bit of cx
+  int first, last;     // words worth reading
+  uint64_t flip;       // xor that turns pixels equal to value into set bits
+  uint64_t right, left;  // bits of word wi at or after / before cx
+};
+
+inline RowWords RowWordsOf(int pitch, int cx, bool value, int limit) {
+  RowWords r;
+  r.wi = cx >> 6;
+  r.b = cx & 63;
+  r.first = std::max(0, (cx - limit) >> 6);
+  r.last = std::min(pitch - 1, (cx + limit) >> 6);
+  r.flip = value ? 0 : ~uint64_t(0);
+  r.right = ~uint64_t(0) << r.b;
+  r.left = ~uint64_t(0) >> (63 - r.b);
+  return r;
+}
+
+inline int32_t RowNearestOne(const uint64_t* row, const RowWords& r, int pitch,
+                             int w, int cx, int limit) {
+  int best = limit + 1;
+  uint64_t word = (row[r.wi] ^ r.flip) & r.right;
+  for (int k = r.wi;;) {
+    if (word) {
+      best = std::min(best, (k << 6) + std::countr_zero(word) - cx);
+      break;
+    }
+    if (++k > r.last) {
+      if (r.flip && k == pitch) best = std::min(best, w - cx);
+      break;
+    }
+    word = row[k] ^ r.flip;
+  }
+  word = (row[r.wi] ^ r.flip) & r.left;
+  for (int k = r.wi;;) {
+    if (word) {
+      best = std::min(best, cx - (k << 6) - 63 + std::countl_zero(word));
+      break;
+    }
+    if (--k < r.first) {
+      if (r.flip && k < 0) best = std::min(best, cx + 1);
+      break;
+    }
+    word = row[k] ^ r.flip;
+  }
+  return best > limit ? limit + 1 : best;
+}
+
+inline void RowNearestScalar(const uint64_t* const* rows, int n, int pitch,
+                             int w, int cx, bool value, int limit,
+                             int32_t* dx) {
+  const RowWords r = RowWordsOf(pitch, cx, value, limit);
+  for (int i = 0; i < n; ++i)
+    dx[i] = RowNearestOne(rows[i], r, pitch, w, cx, limit);
+}
+
+inline int MinDistSqScalar(const int32_t* dx, const int32_t* dy2, int n,
+                           int best) {
+  for (int i = 0; i < n; ++i) best = std::min(best, dx[i] * dx[i] + dy2[i]);
+  return best;
+}
+
+inline void SweepRowScalar(const uint64_t* row, int w, int32_t* run_clear,
+                           int32_t* run_set) {
+  for (int x = 0; x < w; ++x) {
+    bool pix = (row[x >> 6] >> (x & 63)) & 1;
+    run_set[x] = pix ? 0 : run_set[x] + 1;
+    run_clear[x] = pix ? run_clear[x] + 1 : 0;
+  }
+}
+
+#if SDF_X86
+SDF_TARGET("sse4.1")
+inline int MinDistSqSse41(const int32_t* dx, const int32_t* dy2, int n,
+                          int best) {
+  __m128i acc = _mm_set1_epi32(best);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dx + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dy2 + i));
+    acc = _mm_min_epi32(acc, _mm_add_epi32(_mm_mullo_epi32(d, d), y));
+  }
+  acc = _mm_min_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_min_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  return MinDistSqScalar(dx + i, dy2 + i, n - i, _mm_cvtsi128_si32(acc));
+}
+
+// Set bits of each 64-bit lane.
+SDF_TARGET("sse4.1")
+inline __m128i PopCount64Sse41(__m128i v) {
+  const __m128i lut =
+      _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, nibble));
+  const __m128i hi =
+      _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+  return _mm_sad_epu8(_mm_add_epi8(lo, hi), _mm_setzero_si128());
+}
+
+SDF_TARGET("sse4.1")
+inline __m128i RowWordSse41(const uint64_t* const* rows, int k,
+                            __m128i flip) {
+  return _mm_xor_si128(
+      _mm_set_epi64x(int64_t(rows[1][k]), int64_t(rows[0][k])), flip);
+}
+
+// Two rows per vector. Lane values stay below 2^31 with clear high halves,
+// so 32-bit min and compare act on them as on 64-bit lanes.
+SDF_TARGET("sse4.1")
+inline void RowNearestSse41(const uint64_t* const* rows, int n, int pitch,
+                            int w, int cx, bool value, int limit,
+                            int32_t* dx) {
+  const RowWords r = RowWordsOf(pitch, cx, value, limit);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i flip = _mm_set1_epi64x(int64_t(r.flip));
+  const __m128i none = _mm_set1_epi64x(limit + 1);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const uint64_t* const* q = rows + i;
+    __m128i best = none;
+    // Rightwards: the lowest set bit of the first non-empty word.
+    __m128i pending = ones;
+    __m128i word = _mm_and_si128(RowWordSse41(q, r.wi, flip),
+                                 _mm_set1_epi64x(int64_t(r.right)));
+    for (int k = r.wi;;) {
+      const __m128i hit =
+          _mm_andnot_si128(_mm_cmpeq_epi64(word, zero), pending);
+      const __m128i tz = PopCount64Sse41(
+          _mm_andnot_si128(word, _mm_add_epi64(word, ones)));
+      const __m128i d = _mm_add_epi64(tz, _mm_set1_epi64x((k << 6) - cx));
+      best = _mm_blendv_epi8(best, _mm_min_epi32(best, d), hit);
+      pending = _mm_andnot_si128(hit, pending);
+      if (_mm_testz_si128(pending, pending)) break;
+      if (++k > r.last) {
+        if (r.flip && k == pitch)
+          best = _mm_blendv_epi8(
+              best, _mm_min_epi32(best, _mm_set1_epi64x(w - cx)), pending);
+        break;
+      }
+      word = RowWordSse41(q, k, flip);
+    }
+    // Leftwards: the highest set bit, found by smearing it downwards.
+    pending = ones;
+    word = _mm_and_si128(RowWordSse41(q, r.wi, flip),
+                         _mm_set1_epi64x(int64_t(r.left)));
+    for (int k = r.wi;;) {
+      const __m128i hit =
+          _mm_andnot_si128(_mm_cmpeq_epi64(word, zero), pending);
+      __m128i m = word;
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 1));
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 2));
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 4));
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 8));
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 16));
+      m = _mm_or_si128(m, _mm_srli_epi64(m, 32));
+      const __m128i d = _mm_sub_epi64(_mm_set1_epi64x(cx - (k << 6) + 1),
+                                      PopCount64Sse41(m));
+      best = _mm_blendv_epi8(best, _mm_min_epi32(best, d), hit);
+      pending = _mm_andnot_si128(hit, pending);
+      if (_mm_testz_si128(pending, pending)) break;
+      if (--k < r.first) {
+        if (r.flip && k < 0)
+          best = _mm_blendv_epi8(
+              best, _mm_min_epi32(best, _mm_set1_epi64x(cx + 1)), pending);
+        break;
+      }
+      word = RowWordSse41(q, k, flip);
+    }
+    best = _mm_blendv_epi8(
+        best, none, _mm_cmpgt_epi32(best, _mm_set1_epi64x(limit)));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dx + i),
+                     _mm_shuffle_epi32(best, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  for (; i < n; ++i) dx[i] = RowNearestOne(rows[i], r, pitch, w, cx, limit);
+}
+
+SDF_TARGET("sse4.1")
+inline void SweepRowSse41(const uint64_t* row, int w, int32_t* run_clear,
+                          int32_t* run_set) {
+  const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128i one = _mm_set1_epi32(1);
+  int x = 0;
+  for (; x + 4 <= w; x += 4) {
+    int bits = int((row[x >> 6] >> (x & 63)) & 0xF);
+    __m128i set = _mm_cmpeq_epi32(
+        _mm_and_si128(_mm_set1_epi32(bits), lane_bits), lane_bits);
+    __m128i* ps = reinterpret_cast<__m128i*>(run_set + x);
+    __m128i* pc = reinterpret_cast<__m128i*>(run_clear + x);
+    __m128i rs = _mm_add_epi32(_mm_loadu_si128(ps), one);
+    __m128i rc = _mm_add_epi32(_mm_loadu_si128(pc), one);
+    _mm_storeu_si128(ps, _mm_andnot_si128(set, rs));
+    _mm_storeu_si128(pc, _mm_and_si128(set, rc));
+  }
+  for (; x < w; ++x) {
+    bool pix = (row[x >> 6] >> (x & 63)) & 1;
+    run_set[x] = pix ? 0 : run_set[x] + 1;
+    run_clear[x] = pix ? run_clear[x] + 1 : 0;
+  }
+}
+
+SDF_TARGET("avx2")
+inline int MinDistSqAvx2(const int32_t* dx, const int32_t* dy2, int n,
+                         int best) {
+  __m256i acc = _mm256_set1_epi32(best);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dx + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dy2 + i));
+    acc = _mm256_min_epi32(acc, _mm256_add_epi32(_mm256_mullo_epi32(d, d), y));
+  }
+  __m128i m = _mm_min_epi32(_mm256_castsi256_si128(acc),
+                            _mm256_extracti128_si256(acc, 1));
+  m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return MinDistSqScalar(dx + i, dy2 + i, n - i, _mm_cvtsi128_si32(m));
+}
+
+SDF_TARGET("avx2")
+inline __m256i PopCount64Avx2(__m256i v) {
+  const __m256i lut =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble));
+  const __m256i hi = _mm256_shuffle_epi8(
+      lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+SDF_TARGET("avx2")
+inline __m256i RowWordAvx2(const uint64_t* const* rows, int k,
+                           __m256i flip) {
+  return _mm256_xor_si256(
+      _mm256_setr_epi64x(int64_t(rows[0][k]), int64_t(rows[1][k]),
+                         int64_t(rows[2][k]), int64_t(rows[3][k])),
+      flip);
+}
+
+// RowNearestSse41 with four rows per vector.
+SDF_TARGET("avx2")
+inline void RowNearestAvx2(const uint64_t* const* rows, int n, int pitch,
+                           int w, int cx, bool value, int limit,
+                           int32_t* dx) {
+  const RowWords r = RowWordsOf(pitch, cx, value, limit);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i flip = _mm256_set1_epi64x(int64_t(r.flip));
+  const __m256i none = _mm256_set1_epi64x(limit + 1);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const uint64_t* const* q = rows + i;
+    __m256i best = none;
+    __m256i pending = ones;
+    __m256i word = _mm256_and_si256(RowWordAvx2(q, r.wi, flip),
+                                    _mm256_set1_epi64x(int64_t(r.right)));
+    for (int k = r.wi;;) {
+      const __m256i hit =
+          _mm256_andnot_si256(_mm256_cmpeq_epi64(word, zero), pending);
+      const __m256i tz = PopCount64Avx2(
+          _mm256_andnot_si256(word, _mm256_add_epi64(word, ones)));
+      const __m256i d =
+          _mm256_add_epi64(tz, _mm256_set1_epi64x((k << 6) - cx));
+      best = _mm256_blendv_epi8(best, _mm256_min_epi32(best, d), hit);
+      pending = _mm256_andnot_si256(hit, pending);
+      if (_mm256_testz_si256(pending, pending)) break;
+      if (++k > r.last) {
+        if (r.flip && k == pitch)
+          best = _mm256_blendv_epi8(
+              best, _mm256_min_epi32(best, _mm256_set1_epi64x(w - cx)),
+              pending);
+        break;
+      }
+      word = RowWordAvx2(q, k, flip);
+    }
+    pending = ones;
+    word = _mm256_and_si256(RowWordAvx2(q, r.wi, flip),
+                            _mm256_set1_epi64x(int64_t(r.left)));
+    for (int k = r.wi;;) {
+      const __m256i hit =
+          _mm256_andnot_si256(_mm256_cmpeq_epi64(word, zero), pending);
+      __m256i m = word;
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 1));
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 2));
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 4));
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 8));
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 16));
+      m = _mm256_or_si256(m, _mm256_srli_epi64(m, 32));
+      const __m256i d = _mm256_sub_epi64(
+          _mm256_set1_epi64x(cx - (k << 6) + 1), PopCount64Avx2(m));
+      best = _mm256_blendv_epi8(best, _mm256_min_epi32(best, d), hit);
+      pending = _mm256_andnot_si256(hit, pending);
+      if (_mm256_testz_si256(pending, pending)) break;
+      if (--k < r.first) {
+        if (r.flip && k < 0)
+          best = _mm256_blendv_epi8(
+              best, _mm256_min_epi32(best, _mm256_set1_epi64x(cx + 1)),
+              pending);
+        break;
+      }
+      word = RowWordAvx2(q, k, flip);
+    }
+    best = _mm256_blendv_epi8(
+        best, none, _mm256_cmpgt_epi32(best, _mm256_set1_epi64x(limit)));
+    const __m256i packed = _mm256_permutevar8x32_epi32(
+        best, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dx + i),
+                     _mm256_castsi256_si128(packed));
+  }
+  for (; i < n; ++i) dx[i] = RowNearestOne(rows[i], r, pitch, w, cx, limit);
+}
+
+SDF_TARGET("avx2")
+inline void SweepRowAvx2(const uint64_t* row, int w, int32_t* run_clear,
+                         int32_t* run_set) {
+  const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256i one = _mm256_set1_epi32(1);
+  int x = 0;
+  for (; x + 8 <= w; x += 8) {
+    int bits = int((row[x >> 6] >> (x & 63)) & 0xFF);
+    __m256i set = _mm256_cmpeq_epi32(
+        _mm256_and_si256(_mm256_set1_epi32(bits), lane_bits), lane_bits);
+    __m256i* ps = reinterpret_cast<__m256i*>(run_set + x);
+    __m256i* pc = reinterpret_cast<__m256i*>(run_clear + x);
+    __m256i rs = _mm256_add_epi32(_mm256_loadu_si256(ps), one);
+    __m256i rc = _mm256_add_epi32(_mm256_loadu_si256(pc), one);
+    _mm256_storeu_si256(ps, _mm256_andnot_si256(set, rs));
+    _mm256_storeu_si256(pc, _mm256_and_si256(set, rc));
+  }
+  for (; x < w; ++x) {
+    bool pix = (row[x >> 6] >> (x & 63)) & 1;
+    run_set[x] = pix ? 0 : run_set[x] + 1;
+    run_clear[x] = pix ? run_clear[x] + 1 : 0;
+  }
+}
+
+inline void CpuId(int leaf, int sub, int out[4]) {
+#ifdef _MSC_VER
+  __cpuidex(out, leaf, sub);
+#else
+  unsigned a, b, c, d;
+  __cpuid_count(leaf, sub, a, b, c, d);
+  out[0] = int(a);
+  out[1] = int(b);
+  out[2] = int(c);
+  out[3] = int(d);
+#endif
+}
+
+inline uint64_t XGetBv0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (uint64_t(hi) << 32) | lo;
+#endif
+}
+#endif  // SDF_X86
+
+#if SDF_NEON
+inline uint64x2_t PopCount64Neon(uint64x2_t v) {
+  const uint8x16_t bytes = vcntq_u8(vreinterpretq_u8_u64(v));
+  return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bytes)));
+}
+
+inline uint64x2_t RowWordNeon(const uint64_t* const* rows, int k,
+                              uint64x2_t flip) {
+  return veorq_u64(vcombine_u64(vcreate_u64(rows[0][k]),
+                                vcreate_u64(rows[1][k])),
+                   flip);
+}
+
+// RowNearestSse41 on NEON, two rows per vector.
+inline void RowNearestNeon(const uint64_t* const* rows, int n, int pitch,
+                           int w, int cx, bool value, int limit,
+                           int32_t* dx) {
+  const RowWords r = RowWordsOf(pitch, cx, value, limit);
+  const uint64x2_t zero = vdupq_n_u64(0);
+  const uint64x2_t ones = vdupq_n_u64(~uint64_t(0));
+  const uint64x2_t flip = vdupq_n_u64(r.flip);
+  const uint64x2_t none = vdupq_n_u64(uint64_t(limit + 1));
+  auto take = [](uint64x2_t best, uint64x2_t d, uint64x2_t mask) {
+    return vbslq_u64(vandq_u64(mask, vcltq_u64(d, best)), d, best);
+  };
+  auto empty = [](uint64x2_t v) {
+    return vmaxvq_u32(vreinterpretq_u32_u64(v)) == 0;
+  };
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const uint64_t* const* q = rows + i;
+    uint64x2_t best = none;
+    uint64x2_t pending = ones;
+    uint64x2_t word =
+        vandq_u64(RowWordNeon(q, r.wi, flip), vdupq_n_u64(r.right));
+    for (int k = r.wi;;) {
+      const uint64x2_t hit = vbicq_u64(pending, vceqq_u64(word, zero));
+      const uint64x2_t tz =
+          PopCount64Neon(vbicq_u64(vsubq_u64(word, vdupq_n_u64(1)), word));
+      best = take(best, vaddq_u64(tz, vdupq_n_u64(uint64_t((k << 6) - cx))),
+                  hit);
+      pending = vbicq_u64(pending, hit);
+      if (empty(pending)) break;
+      if (++k > r.last) {
+        if (r.flip && k == pitch)
+          best = take(best, vdupq_n_u64(uint64_t(w - cx)), pending);
+        break;
+      }
+      word = RowWordNeon(q, k, flip);
+    }
+    pending = ones;
+    word = vandq_u64(RowWordNeon(q, r.wi, flip), vdupq_n_u64(r.left));
+    for (int k = r.wi;;) {
+      const uint64x2_t hit = vbicq_u64(pending, vceqq_u64(word, zero));
+      uint64x2_t m = word;
+      m = vorrq_u64(m, vshrq_n_u64(m, 1));
+      m = vorrq_u64(m, vshrq_n_u64(m, 2));
+      m = vorrq_u64(m, vshrq_n_u64(m, 4));
+      m = vorrq_u64(m, vshrq_n_u64(m, 8));
+      m = vorrq_u64(m, vshrq_n_u64(m, 16));
+      m = vorrq_u64(m, vshrq_n_u64(m, 32));
+      best = take(best,
+                  vsubq_u64(vdupq_n_u64(uint64_t(cx - (k << 6) + 1)),
+                            PopCount64Neon(m)),
+                  hit);
+      pending = vbicq_u64(pending, hit);
+      if (empty(pending)) break;
+      if (--k < r.first) {
+        if (r.flip && k < 0)
+          best = take(best, vdupq_n_u64(uint64_t(cx + 1)), pending);
+        break;
+      }
+      word = RowWordNeon(q, k, flip);
+    }
+    best = vbslq_u64(vcgtq_u64(best, vdupq_n_u64(uint64_t(limit))), none, best);
+    vst1_s32(dx + i, vreinterpret_s32_u32(vmovn_u64(best)));
+  }
+  for (; i < n; ++i) dx[i] = RowNearestOne(rows[i], r, pitch, w, cx, limit);
+}
+
+inline int MinDistSqNeon(const int32_t* dx, const int32_t* dy2, int n,
+                         int best) {
+  int32x4_t acc = vdupq_n_s32(best);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    int32x4_t d = vld1q_s32(dx + i);
+    acc = vminq_s32(acc, vmlaq_s32(vld1q_s32(dy2 + i), d, d));
+  }
+  return MinDistSqScalar(dx + i, dy2 + i, n - i, vminvq_s32(acc));
+}
+
+inline void SweepRowNeon(const uint64_t* row, int w, int32_t* run_clear,
+                         int32_t* run_set) {
+  const int32_t lane_init[4] = {1, 2, 4, 8};
+  const int32x4_t lane_bits = vld1q_s32(lane_init);
+  const int32x4_t one = vdupq_n_s32(1);
+  int x = 0;
+  for (; x + 4 <= w; x += 4) {
+    int32_t bits = int32_t((row[x >> 6] >> (x & 63)) & 0xF);
+    int32x4_t set = vreinterpretq_s32_u32(
+        vceqq_s32(vandq_s32(vdupq_n_s32(bits), lane_bits), lane_bits));
+    int32x4_t rs = vaddq_s32(vld1q_s32(run_set + x), one);
+    int32x4_t rc = vaddq_s32(vld1q_s32(run_clear + x), one);
+    vst1q_s32(run_set + x, vbicq_s32(rs, set));
+    vst1q_s32(run_clear + x, vandq_s32(rc, set));
+  }
+  for (; x < w; ++x) {
+    bool pix = (row[x >> 6] >> (x & 63)) & 1;
+    run_set[x] = pix ? 0 : run_set[x] + 1;
+    run_clear[x] = pix ? run_clear[x] + 1 : 0;
+  }
+}
+#endif  // SDF_NEON
+
+}  // namespace kernels
+
+// Every variant the running CPU supports, best first; the scalar reference
+// always comes last.
+inline std::vector<DistanceKernels> SupportedKernels() {
+  std::vector<DistanceKernels> out;
+#if SDF_X86
+  int r[4];
+  kernels::CpuId(0, 0, r);
+  const int max_leaf = r[0];
+  kernels::CpuId(1, 0, r);
+  const bool sse41 = r[2] & (1 << 19);
+  const bool osxsave = r[2] & (1 << 27);
+  const bool avx = r[2] & (1 << 28);
+  bool avx2 = false;
+  if (max_leaf >= 7 && osxsave && avx && (kernels::XGetBv0() & 6) == 6) {
+    kernels::CpuId(7, 0, r);
+    avx2 = r[1] & (1 << 5);
+  }
+  if (avx2)
+    out.push_back({"AVX2", kernels::RowNearestAvx2, kernels::MinDistSqAvx2,
+                   kernels::SweepRowAvx2});
+  if (sse41)
+    out.push_back({"SSE4.1", kernels::RowNearestSse41,
+                   kernels::MinDistSqSse41, kernels::SweepRowSse41});
+#elif SDF_NEON
+  out.push_back({"NEON", kernels::RowNearestNeon, kernels::MinDistSqNeon,
+                 kernels::SweepRowNeon});
+#endif
+  out.push_back({"scalar", kernels::RowNearestScalar,
+                 kernels::MinDistSqScalar, kernels::SweepRowScalar});
+  return out;
+}
+
+inline DistanceKernels DetectKernels() { return SupportedKernels().front(); }
+
+// Chosen once, on first use, from what the running CPU supports.
+inline const DistanceKernels& Kernels() {
+  static const DistanceKernels k = DetectKernels();
+  return k;
+}
+
+}  // namespace sdf
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "BitPlane.h"
+
+namespace sdf {
+
+// Texel cells around the texel being queried, ordered by the squared
+// distance from its sample point to the nearest hi-res pixel of the cell.
+// Offsets are in texels, so the table stays a few hundred entries however
+// fine the supersampling, and each cell is tested a row of words at a time.
+struct SpiralCell {
+  int16_t dx, dy;
+  int32_t d2;  // lower bound for every pixel of the cell
+};
+
+// Hi-res pixels between the sample point (ss / 2 into its texel) and the
+// nearest column of the texel i cells away.
+constexpr int SpiralGap(int i, int ss) {
+  return i > 0 ? i * ss - ss / 2 : i < 0 ? -i * ss - ss / 2 + 1 : 0;
+}
+
+// Cells with a pixel closer than radius hi-res pixels.
+constexpr size_t SpiralSize(int ss, int radius) {
+  const int n = radius / ss + 1;
+  size_t count = 0;
+  for (int dy = -n; dy <= n; ++dy)
+    for (int dx = -n; dx <= n; ++dx) {
+      const int gx = SpiralGap(dx, ss), gy = SpiralGap(dy, ss);
+      count += gx * gx + gy * gy < radius * radius;
+    }
+  return count;
+}
+
+constexpr void FillSpiral(int ss, int radius, SpiralCell* out) {
+  const int n = radius / ss + 1;
+  size_t count = 0;
+  for (int dy = -n; dy <= n; ++dy)
+    for (int dx = -n; dx <= n; ++dx) {
+      const int gx = SpiralGap(dx, ss), gy = SpiralGap(dy, ss);
+      if (gx * gx + gy * gy < radius * radius)
+        out[count++] = {int16_t(dx), int16_t(dy), gx * gx + gy * gy};
+    }
+  std::sort(out, out + count, [](const SpiralCell& a, const SpiralCell& b) {
+    return a.d2 < b.d2;
+  });
+}
+
+// Table for a supersample and radius known at compile time.
+template <int SS, int Radius>
+inline constexpr auto kSpiral = [] {
+  std::array<SpiralCell, SpiralSize(SS, Radius)> table{};
+  FillSpiral(SS, Radius, table.data());
+  return table;
+}();
+
+inline std::vector<SpiralCell> BuildSpiral(int ss, int radius) {
+  std::vector<SpiralCell> table(SpiralSize(ss, radius));
+  FillSpiral(ss, radius, table.data());
+  return table;
+}
+
+// Squared distance from (cx, cy), the sample point of its texel, to the
+// nearest pixel equal to value, or limit when none is closer. state(tx, ty)
+// tells whether texel cell (tx, ty) is all clear (0), all set (1) or mixed
+// (2); cells off the plane are clear. Cells are visited nearest first: a
+// uniform match is exactly its bound away and ends the walk, a mixed cell is
+// scanned a row of words at a time, and the walk stops at the first bound
+// that cannot beat the best hit.
+template <class CellState>
+int SpiralNearestSq(const BitPlane& bp, std::span<const SpiralCell> table,
+                    int ss, int cx, int cy, bool value, int limit,
+                    CellState&& state) {
+  const int tx = cx / ss, ty = cy / ss;
+  int best = limit;
+  for (const SpiralCell& c : table) {
+    if (c.d2 >= best) break;
+    const int st = state(tx + c.dx, ty + c.dy);
+    if (st == int(!value)) continue;
+    if (st == int(value)) return c.d2;
+    const int x0 = (tx + c.dx) * ss, y0 = (ty + c.dy) * ss;
+    for (int y = y0; y < y0 + ss; ++y) {
+      const int dy2 = (y - cy) * (y - cy);
+      if (dy2 >= best) continue;
+      const int dx = bp.NearestInSpan(y, x0, x0 + ss - 1, cx, value);
+      if (dx >= 0) best = std::min(best, dx * dx + dy2);
+    }
+  }
+  return best;
+}
+
+}  // namespace sdf
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sdf {
+
+// Work-stealing pool. Submit() feeds a shared FIFO, so top-level tasks start
+// in submission order; subtasks from ParallelFor go to the calling worker's
+// own deque, which it pops newest-first while idle workers steal the oldest
+// entries. A thread waiting for its chunks keeps running local or stolen
+// work instead of blocking, so nested splits never starve the pool.
+//
+// A split allocates nothing: its state lives on the caller's stack, the
+// deques hold plain pointers to it, and every queue is a ring that only
+// grows past its high-water mark.
+class TaskPool {
+ public:
+  explicit TaskPool(unsigned threads) {
+    threads = std::max(1u, threads);
+    for (unsigned i = 0; i < threads; ++i)
+      local_.push_back(std::make_unique<Queue<Split*>>());
+    for (unsigned i = 0; i < threads; ++i)
+      threads_.emplace_back([this, i] { Loop(int(i)); });
+  }
+  ~TaskPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  unsigned Size() const noexcept { return unsigned(threads_.size()); }
+
+  void Submit(std::function<void()> fn) {
+    Push(shared_, std::move(fn));
+  }
+
+  // Blocks until every submitted task, subtasks included, has finished.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    idle_cv_.wait(lock, [&] { return pending_.load() == 0; });
+  }
+
+  // Calls fn(b, e) over [begin, end) in chunks of grain, spread across the
+  // pool; the caller works on chunks too and returns once all are done and
+  // every helper it pushed has let go of the split.
+  template <class Fn>
+  void ParallelFor(int begin, int end, int grain, Fn&& fn) {
+    const int chunks = (end - begin + grain - 1) / grain;
+    if (chunks <= 1 || Size() == 1) {
+      if (begin < end) fn(begin, end);
+      return;
+    }
+    using Body = std::remove_reference_t<Fn>;
+    Split st;
+    st.body = [](void* f, int b, int e) { (*static_cast<Body*>(f))(b, e); };
+    st.fn = const_cast<void*>(static_cast<const void*>(&fn));
+    st.begin = begin;
+    st.end = end;
+    st.grain = grain;
+    st.chunks = chunks;
+    const int helpers = std::min(chunks - 1, int(Size()) - 1);
+    st.helpers.store(helpers, std::memory_order_relaxed);
+    const int self = Self();
+    Queue<Split*>& q = self >= 0 ? *local_[self] : external_;
+    for (int i = 0; i < helpers; ++i) Push(q, &st);
+    Run(st);
+    // New top-level work is left alone here so this glyph finishes first.
+    while (st.done.load(std::memory_order_acquire) < chunks ||
+           st.helpers.load(std::memory_order_acquire) > 0) {
+      Split* other;
+      if (TryPopSplit(other)) {
+        Help(*other);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  // One ParallelFor call. fn is the caller's functor, called through body.
+  struct Split {
+    void (*body)(void*, int, int);
+    void* fn;
+    int begin, end, grain, chunks;
+    std::atomic<int> next{0};
+    std::atomic<int> done{0};
+    std::atomic<int> helpers{0};  // pushed and not yet finished with it
+  };
+
+  // FIFO / LIFO ring. It doubles when full and never shrinks, so once a
+  // queue has seen its deepest backlog it stops allocating.
+  template <class T>
+  class Ring {
+   public:
+    Ring() : buf_(64) {}
+    bool empty() const noexcept { return size_ == 0; }
+    void push_back(T v) {
+      if (size_ == buf_.size()) Grow();
+      buf_[(head_ + size_) % buf_.size()] = std::move(v);
+      ++size_;
+    }
+    T pop_front() {
+      T v = std::move(buf_[head_]);
+      head_ = (head_ + 1) % buf_.size();
+      --size_;
+      return v;
+    }
+    T pop_back() {
+      --size_;
+      return std::move(buf_[(head_ + size_) % buf_.size()]);
+    }
+
+   private:
+    std::vector<T> buf_;
+    size_t head_ = 0, size_ = 0;
+
+    void Grow() {
+      std::vector<T> bigger(buf_.size() * 2);
+      for (size_t i = 0; i < size_; ++i)
+        bigger[i] = std::move(buf_[(head_ + i) % buf_.size()]);
+      buf_ = std::move(bigger);
+      head_ = 0;
+    }
+  };
+
+  template <class T>
+  struct Queue {
+    std::mutex mutex;
+    Ring<T> tasks;
+  };
+  std::vector<std::unique_ptr<Queue<Split*>>> local_;
+  Queue<Split*> external_;  // splits of threads outside the pool
+  Queue<std::function<void()>> shared_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> queued_{0};   // tasks sitting in any queue
+  std::atomic<size_t> pending_{0};  // submitted and not yet finished
+  std::mutex sleep_mutex_;
+  std::condition_variable work_cv_, idle_cv_;
+  bool stop_ = false;
+
+  // Worker index of the calling thread in this pool, or -1.
+  static inline thread_local const TaskPool* current_pool_ = nullptr;
+  static inline thread_local int current_index_ = -1;
+  int Self() const { return current_pool_ == this ? current_index_ : -1; }
+
+  template <class T>
+  void Push(Queue<T>& q, T task) {
+    pending_.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    work_cv_.notify_one();
+  }
+
+  template <class T>
+  bool Take(Queue<T>& q, bool back, T& out) {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) return false;
+    out = back ? q.tasks.pop_back() : q.tasks.pop_front();
+    queued_.fetch_sub(1);
+    return true;
+  }
+
+  // Own deque newest-first, then splits of outside threads, then the oldest
+  // split of another worker.
+  bool TryPopSplit(Split*& out) {
+    const int self = Self();
+    if (self >= 0 && Take(*local_[self], true, out)) return true;
+    if (Take(external_, false, out)) return true;
+    const int n = int(local_.size());
+    for (int k = 1; k <= n; ++k) {
+      const int victim = ((self < 0 ? 0 : self) + k) % n;
+      if (victim != self && Take(*local_[victim], false, out)) return true;
+    }
+    return false;
+  }
+
+  static void Run(Split& st) {
+    for (int c; (c = st.next.fetch_add(1)) < st.chunks;) {
+      const int b = st.begin + c * st.grain;
+      st.body(st.fn, b, std::min(st.end, b + st.grain));
+      st.done.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  // A pushed helper. Helpers that start after the last chunk was claimed
+  // return without touching fn; the release on helpers is the last access
+  // to the split, which may leave the caller's stack right after.
+  void Help(Split& st) {
+    Run(st);
+    st.helpers.fetch_sub(1, std::memory_order_release);
+    Finish();
+  }
+
+  void Finish() {
+    if (pending_.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      idle_cv_.notify_all();
+    }
+  }
+
+  void Loop(int index) {
+    current_pool_ = this;
+    current_index_ = index;
+    for (;;) {
+      Split* st;
+      if (Take(*local_[index], true, st)) {
+        Help(*st);
+        continue;
+      }
+      std::function<void()> task;
+      if (Take(shared_, false, task)) {
+        task();
+        Finish();
+        continue;
+      }
+      if (TryPopSplit(st)) {
+        Help(*st);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      if (stop_ && queued_.load() == 0) return;
+      work_cv_.wait(lock, [&] { return stop_ || queued_.load() > 0; });
+    }
+  }
+};
+
+}  // namespace sdf
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "Bc4Encoder.h"
+
+namespace sdf {
+
+// GPU texel formats an atlas is stored in. Three-channel atlases go out as
+// RGBA8 with opaque alpha: 24-bit RGB has no DXGI format and few Vulkan
+// drivers sample it.
+enum class TexelFormat { kR8, kRgba8, kBc4 };
+
+// Mip levels of one texture, each holding every array layer. Level data
+// matches the upload functions byte for byte: rows tightly packed, BC4
+// blocks row by row.
+struct TextureImage {
+  TexelFormat format = TexelFormat::kR8;
+  int w = 0, h = 0;  // level 0
+  int layers = 1;
+  std::vector<std::vector<std::vector<uint8_t>>> levels;  // [level][layer]
+};
+
+namespace container {
+
+inline void Put16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(uint8_t(v));
+  out.push_back(uint8_t(v >> 8));
+}
+inline void Put32(std::vector<uint8_t>& out, uint32_t v) {
+  for (int k = 0; k < 4; ++k) out.push_back(uint8_t(v >> (8 * k)));
+}
+inline void Put64(std::vector<uint8_t>& out, uint64_t v) {
+  for (int k = 0; k < 8; ++k) out.push_back(uint8_t(v >> (8 * k)));
+}
+inline void Set32(std::vector<uint8_t>& out, size_t at, uint32_t v) {
+  for (int k = 0; k < 4; ++k) out[at + k] = uint8_t(v >> (8 * k));
+}
+inline void Set64(std::vector<uint8_t>& out, size_t at, uint64_t v) {
+  for (int k = 0; k < 8; ++k) out[at + k] = uint8_t(v >> (8 * k));
+}
+inline void PadTo(std::vector<uint8_t>& out, size_t align) {
+  out.resize((out.size() + align - 1) / align * align, 0);
+}
+
+inline int BlockBytes(TexelFormat f) {
+  return f == TexelFormat::kR8 ? 1 : f == TexelFormat::kRgba8 ? 4 : 8;
+}
+inline bool IsBlock(TexelFormat f) { return f == TexelFormat::kBc4; }
+
+inline int LevelSide(int side, int level) { return std::max(1, side >> level); }
+
+}  // namespace container
+
+// w x h texels of `channels` bytes in `format`. BC4 pads a partial block by
+// repeating the last row and column.
+inline std::vector<uint8_t> ToTexels(TexelFormat format, const uint8_t* src,
+                                     int w, int h, int channels) {
+  std::vector<uint8_t> out;
+  if (format == TexelFormat::kR8) {
+    out.assign(src, src + size_t(w) * h);
+  } else if (format == TexelFormat::kRgba8) {
+    out.reserve(size_t(w) * h * 4);
+    for (size_t i = 0; i < size_t(w) * h; ++i, src += channels) {
+      out.insert(out.end(), src, src + channels);
+      if (channels == 3) out.push_back(255);
+    }
+  } else {
+    const int bw = (w + 3) / 4 * 4, bh = (h + 3) / 4 * 4;
+    std::vector<uint8_t> padded;
+    if (bw != w || bh != h) {
+      padded.resize(size_t(bw) * bh);
+      for (int y = 0; y < bh; ++y)
+        for (int x = 0; x < bw; ++x)
+          padded[size_t(y) * bw + x] =
+              src[size_t(std::min(y, h - 1)) * w + std::min(x, w - 1)];
+      src = padded.data();
+    }
+    out.resize(Bc4Size(bw, bh));
+    EncodeBc4Rows(src, bw, 0, bh / 4, out.data());
+  }
+  return out;
+}
+
+// KTX 2.0 file without supercompression. The key/value data marks rows as
+// running downwards, as the atlas stores them.
+inline std::vector<uint8_t> Ktx2File(const TextureImage& img) {
+  using namespace container;
+  static const uint8_t kIdentifier[12] = {0xAB, 'K',  'T',  'X',  ' ', '2',
+                                          '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+  const int levels = int(img.levels.size());
+  const int block = BlockBytes(img.format);
+  const uint32_t vk_format = img.format == TexelFormat::kR8      ? 9
+                             : img.format == TexelFormat::kRgba8 ? 37
+                                                                 : 139;
+  std::vector<uint8_t> out(kIdentifier, kIdentifier + 12);
+  Put32(out, vk_format);
+  Put32(out, 1);  // typeSize
+  Put32(out, uint32_t(img.w));
+  Put32(out, uint32_t(img.h));
+  Put32(out, 0);  // pixelDepth
+  Put32(out, img.layers > 1 ? uint32_t(img.layers) : 0);
+  Put32(out, 1);  // faceCount
+  Put32(out, uint32_t(levels));
+  Put32(out, 0);  // supercompressionScheme
+  const size_t index = out.size();
+  out.resize(index + 32 + size_t(levels) * 24, 0);
+
+  // Data format descriptor: one basic block.
+  const int samples = img.format == TexelFormat::kRgba8 ? 4 : 1;
+  const size_t dfd = out.size();
+  Put32(out, uint32_t(4 + 24 + 16 * samples));
+  Put32(out, 0);  // Khronos vendor, basic descriptor type
+  Put16(out, 2);  // version 1.3
+  Put16(out, uint16_t(24 + 16 * samples));
+  out.push_back(IsBlock(img.format) ? 131 : 1);  // BC4 or RGBSDA model
+  out.push_back(1);                              // BT.709 primaries
+  out.push_back(1);                              // linear transfer
+  out.push_back(0);                              // straight alpha
+  for (int k = 0; k < 4; ++k)
+    out.push_back(IsBlock(img.format) && k < 2 ? 3 : 0);  // block size - 1
+  out.push_back(uint8_t(block));  // bytesPlane0
+  out.resize(out.size() + 7, 0);
+  for (int s = 0; s < samples; ++s) {
+    const bool bc = IsBlock(img.format);
+    Put16(out, uint16_t(bc ? 0 : 8 * s));   // bitOffset
+    out.push_back(bc ? 63 : 7);              // bitLength - 1
+    out.push_back(uint8_t(s == 3 ? 15 : s)); // R, G, B, then alpha
+    Put32(out, 0);                           // sample position
+    Put32(out, 0);                           // sampleLower
+    Put32(out, bc ? 0xFFFFFFFFu : 255);      // sampleUpper
+  }
+  const size_t kvd = out.size();
+  static const char kOrientation[] = "KTXorientation\0rd";
+  Put32(out, sizeof(kOrientation));
+  out.insert(out.end(), kOrientation, kOrientation + sizeof(kOrientation));
+  PadTo(out, 4);
+  const size_t kvd_end = out.size();
+
+  Set32(out, index, uint32_t(dfd));
+  Set32(out, index + 4, uint32_t(kvd - dfd));
+  Set32(out, index + 8, uint32_t(kvd));
+  Set32(out, index + 12, uint32_t(kvd_end - kvd));
+  // Smallest level first; each starts on a multiple of its block size and 4.
+  const size_t align = std::lcm(size_t(block), size_t(4));
+  for (int l = levels - 1; l >= 0; --l) {
+    PadTo(out, align);
+    const size_t at = out.size();
+    for (const std::vector<uint8_t>& layer : img.levels[l])
+      out.insert(out.end(), layer.begin(), layer.end());
+    const size_t entry = index + 32 + size_t(l) * 24;
+    Set64(out, entry, at);
+    Set64(out, entry + 8, out.size() - at);
+    Set64(out, entry + 16, out.size() - at);
+  }
+  return out;
+}
+
+// DDS file with the DX10 extension header; array layers each carry their
+// full mip chain, largest level first.
+inline std::vector<uint8_t> DdsFile(const TextureImage& img) {
+  using namespace container;
+  const int levels = int(img.levels.size());
+  const bool bc = IsBlock(img.format);
+  const uint32_t top =
+      bc ? uint32_t(Bc4Size((img.w + 3) / 4 * 4, (img.h + 3) / 4 * 4))
+         : uint32_t(img.w * BlockBytes(img.format));
+  std::vector<uint8_t> out = {'D', 'D', 'S', ' '};
+  Put32(out, 124);
+  // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT, then LINEARSIZE for
+  // blocks or PITCH for rows.
+  Put32(out, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (bc ? 0x80000 : 0x8));
+  Put32(out, uint32_t(img.h));
+  Put32(out, uint32_t(img.w));
+  Put32(out, top);
+  Put32(out, 0);  // depth
+  Put32(out, uint32_t(levels));
+  out.resize(out.size() + 11 * 4, 0);
+  // Pixel format: a FourCC of DX10 defers to the extension header.
+  Put32(out, 32);
+  Put32(out, 0x4);
+  out.insert(out.end(), {'D', 'X', '1', '0'});
+  out.resize(out.size() + 5 * 4, 0);
+  // TEXTURE, plus COMPLEX | MIPMAP with more than one level.
+  Put32(out, 0x1000 | (levels > 1 ? 0x8 | 0x400000 : 0));
+  out.resize(out.size() + 4 * 4, 0);
+
+  Put32(out, img.format == TexelFormat::kR8      ? 61
+             : img.format == TexelFormat::kRgba8 ? 28
+                                                 : 80);
+  Put32(out, 3);  // TEXTURE2D
+  Put32(out, 0);
+  Put32(out, uint32_t(img.layers));
+  Put32(out, 0);
+  for (int layer = 0; layer < img.layers; ++layer)
+    for (int l = 0; l < levels; ++l)
+      out.insert(out.end(), img.levels[l][layer].begin(),
+                 img.levels[l][layer].end());
+  return out;
+}
+
+}  // namespace sdf
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Crc32.h"
+
+namespace sdf {
+
+inline constexpr uint64_t kFnv1aSeed = 0xcbf29ce484222325ull;
+
+// 64-bit FNV-1a. Passing the previous result as h hashes several pieces as
+// if they were one buffer.
+inline uint64_t Fnv1a(const void* data, size_t n, uint64_t h = kFnv1aSeed) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 0x100000001b3ull;
+  return h;
+}
+
+// Finished tiles kept on disk between runs, keyed by font hash, parameter
+// hash and glyph id. The file is a magic followed by records; records of
+// other fonts or settings are skipped, not dropped, so switching back costs
+// nothing. The cache only saves work: a missing or foreign file reads as
+// empty, and loading stops at the first record that is cut short or fails
+// its CRC, which is cut off before appending. Once superseded records make
+// up most of the file it is rewritten with only the latest of each.
+class TileCache {
+ public:
+  // An empty path disables the cache.
+  TileCache(std::string path, uint64_t font_hash, uint64_t params_hash)
+      : path_(std::move(path)),
+        font_hash_(font_hash),
+        params_hash_(params_hash) {
+    if (!path_.empty()) Read();
+  }
+
+  // Copies the cached tile of gid to out; false when there is none of
+  // exactly bytes bytes.
+  bool Load(uint16_t gid, uint8_t* out, size_t bytes) const {
+    auto it = at_.find(gid);
+    if (it == at_.end() || it->second.bytes != bytes) return false;
+    std::memcpy(out, &blob_[it->second.offset], bytes);
+    return true;
+  }
+
+  // Queues a tile for the next Flush().
+  void Add(uint16_t gid, const uint8_t* tile, size_t bytes) {
+    if (path_.empty()) return;
+    Record r{font_hash_, params_hash_, gid, uint32_t(bytes)};
+    r.crc = RecordCrc(r, tile);
+    const uint8_t* head = reinterpret_cast<const uint8_t*>(&r);
+    pending_.insert(pending_.end(), head, head + sizeof(r));
+    pending_.insert(pending_.end(), tile, tile + bytes);
+  }
+
+  // Appends the queued tiles; false when the file cannot be written.
+  bool Flush() {
+    if (path_.empty() || pending_.empty()) return true;
+    std::error_code ec;
+    if (valid_end_ == 0) {
+      std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+      out.write(kMagic, sizeof(kMagic));
+      if (!out) return false;
+      valid_end_ = sizeof(kMagic);
+    } else if (std::filesystem::file_size(path_, ec) != valid_end_) {
+      std::filesystem::resize_file(path_, valid_end_, ec);
+      if (ec) return false;
+    }
+    std::ofstream out(path_, std::ios::binary | std::ios::app);
+    out.write(reinterpret_cast<const char*>(pending_.data()),
+              std::streamsize(pending_.size()));
+    if (!out) return false;
+    valid_end_ += pending_.size();
+    pending_.clear();
+    return true;
+  }
+
+ private:
+  static constexpr char kMagic[8] = {'S', 'D', 'F', 'T', 'C', '2', 0, 0};
+  struct Record {
+    uint64_t font_hash;
+    uint64_t params_hash;
+    uint32_t gid;
+    uint32_t bytes;
+    uint32_t crc = 0;  // of the fields above and the tile
+    uint32_t reserved = 0;
+  };
+  static_assert(sizeof(Record) == 32);
+
+  static uint32_t RecordCrc(const Record& r, const uint8_t* tile) {
+    return Crc32(tile, r.bytes,
+                 Crc32(reinterpret_cast<const uint8_t*>(&r),
+                       offsetof(Record, crc)));
+  }
+
+  std::string path_;
+  struct Span {
+    size_t offset, bytes;
+  };
+  uint64_t font_hash_, params_hash_;
+  std::vector<uint8_t> blob_;              // matching tiles, back to back
+  std::unordered_map<uint16_t, Span> at_;  // where each gid sits in blob_
+  std::vector<uint8_t> pending_;             // records not yet written
+  uint64_t valid_end_ = 0;  // end of the last whole record; 0 = no file
+
+  // Where a whole record sits in the file, for compaction.
+  struct Extent {
+    uint64_t offset, bytes;
+  };
+
+  void Read() {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(path_, ec);
+    std::ifstream in(path_, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    if (ec || !in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kMagic, sizeof(kMagic)))
+      return;
+    valid_end_ = sizeof(kMagic);
+    // The latest record of every key, whatever its font or settings.
+    std::unordered_map<uint64_t, Extent> latest;
+    std::vector<uint8_t> tile;
+    Record r;
+    while (in.read(reinterpret_cast<char*>(&r), sizeof(r)) &&
+           r.gid <= 0xFFFF && valid_end_ + sizeof(r) + r.bytes <= size) {
+      tile.resize(r.bytes);
+      if (!in.read(reinterpret_cast<char*>(tile.data()), r.bytes) ||
+          RecordCrc(r, tile.data()) != r.crc)
+        break;
+      if (r.font_hash == font_hash_ && r.params_hash == params_hash_) {
+        const size_t at = blob_.size();
+        blob_.insert(blob_.end(), tile.begin(), tile.end());
+        at_[uint16_t(r.gid)] = {at, r.bytes};
+      }
+      const uint64_t key =
+          Fnv1a(&r, offsetof(Record, bytes));  // font, settings and gid
+      latest[key] = {valid_end_, sizeof(r) + r.bytes};
+      valid_end_ += sizeof(r) + r.bytes;
+    }
+    uint64_t live = 0;
+    for (const auto& [key, e] : latest) live += e.bytes;
+    if (valid_end_ - sizeof(kMagic) - live > kMaxDeadBytes &&
+        live < (valid_end_ - sizeof(kMagic)) / 2) {
+      std::vector<Extent> keep;
+      for (const auto& [key, e] : latest) keep.push_back(e);
+      Compact(in, keep);
+    }
+  }
+
+  // Superseded bytes tolerated before the file is rewritten, and then only
+  // when they outweigh the live records.
+  static constexpr uint64_t kMaxDeadBytes = 1 << 20;
+
+  // Rewrites the file with only the records in keep, in file order. On any
+  // failure the old file stays as it is.
+  void Compact(std::ifstream& in, std::vector<Extent>& keep) {
+    std::sort(keep.begin(), keep.end(),
+              [](const Extent& a, const Extent& b) {
+                return a.offset < b.offset;
+              });
+    const std::string tmp = path_ + ".tmp";
+    std::error_code ec;
+    {
+      in.clear();
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(kMagic, sizeof(kMagic));
+      std::vector<char> buf;
+      for (const Extent& e : keep) {
+        buf.resize(e.bytes);
+        if (!in.seekg(std::streamoff(e.offset)) ||
+            !in.read(buf.data(), std::streamsize(e.bytes)))
+          break;
+        out.write(buf.data(), std::streamsize(e.bytes));
+      }
+      if (!in || !out) {
+        out.close();
+        std::filesystem::remove(tmp, ec);
+        return;
+      }
+    }
+    in.close();
+    std::filesystem::rename(tmp, path_, ec);
+    if (ec) {
+      std::filesystem::remove(tmp, ec);
+      return;
+    }
+    valid_end_ = sizeof(kMagic);
+    for (const Extent& e : keep) valid_end_ += e.bytes;
+  }
+};
+
+}  // namespace sdf
@@ -0,0 +1,109 @@
+// Checks that AsyncWriter::Finish() writes out every job whose Push returned
+// before it, including jobs pushed while the writer thread is deciding to
+// leave.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\AsyncWriterTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/AsyncWriterTest.cpp
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "AsyncWriter.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in),
+          std::istreambuf_iterator<char>()};
+}
+
+// Job k of a file is the byte k + 1 at offset k.
+bool Complete(const std::vector<uint8_t>& bytes, int jobs) {
+  if (int(bytes.size()) != jobs) return false;
+  for (int k = 0; k < jobs; ++k)
+    if (bytes[k] != uint8_t(k + 1)) return false;
+  return true;
+}
+
+// The calling thread pushes and finishes at once, as the atlas does with
+// its last band or texture.
+void TestLastPush(const std::filesystem::path& dir) {
+  const std::filesystem::path path = dir / "last_push.bin";
+  static const uint8_t kBytes[] = {1, 2, 3};
+  for (int round = 0; round < 20000; ++round) {
+    sdf::AsyncWriter writer(4);
+    sdf::AsyncWriter::File* file = writer.Open(path);
+    for (int k = 0; k < 3; ++k)
+      writer.Write(file, k, std::span<const uint8_t>(kBytes + k, 1));
+    CHECK(writer.Finish());
+    if (!Complete(ReadFile(path), 3)) {
+      CHECK(!"a job pushed before Finish() was dropped");
+      return;
+    }
+  }
+}
+
+// Producers on other threads push through a small queue; Finish() starts
+// the moment the last Push returns.
+void TestProducers(const std::filesystem::path& dir) {
+  const std::filesystem::path path = dir / "producers.bin";
+  constexpr int kThreads = 4, kPerThread = 64, kJobs = kThreads * kPerThread;
+  for (int round = 0; round < 200; ++round) {
+    sdf::AsyncWriter writer(8);
+    sdf::AsyncWriter::File* file = writer.Open(path);
+    std::atomic<int> pushed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < kPerThread; ++i) {
+          const int k = i * kThreads + t;
+          writer.Write(file, k, [k](std::vector<uint8_t>& buf) {
+            buf.push_back(uint8_t(k + 1));
+          });
+          pushed.fetch_add(1);
+        }
+      });
+    while (pushed.load() < kJobs) std::this_thread::yield();
+    CHECK(writer.Finish());
+    for (std::thread& t : threads) t.join();
+    if (!Complete(ReadFile(path), kJobs)) {
+      CHECK(!"a job pushed before Finish() was dropped");
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "AsyncWriterTest";
+  std::filesystem::create_directories(dir);
+  TestLastPush(dir);
+  TestProducers(dir);
+  std::filesystem::remove_all(dir);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("AsyncWriter: all checks passed");
+  return EXIT_SUCCESS;
+}
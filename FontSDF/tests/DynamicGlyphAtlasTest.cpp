@@ -0,0 +1,258 @@
+// Checks of DynamicGlyphAtlas against a font built in memory: eviction
+// order, frame pinning, dirty rects, the per-frame budget and glyphs too
+// large for a cell.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\DynamicGlyphAtlasTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/DynamicGlyphAtlasTest.cpp
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include "DynamicGlyphAtlas.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+void Put16(std::vector<uint8_t>& v, uint32_t x) {
+  v.push_back(uint8_t(x >> 8));
+  v.push_back(uint8_t(x));
+}
+void Put32(std::vector<uint8_t>& v, uint32_t x) {
+  Put16(v, x >> 16);
+  Put16(v, x);
+}
+
+// A TrueType font with 1000 units per em whose glyph i (1-based), mapped
+// from 'A' + i - 1, is a square of side sides[i - 1] at the origin. The
+// head bounding box covers the squares up to `bbox` units.
+std::vector<uint8_t> SquareFont(const std::vector<int>& sides, int bbox) {
+  const int n = int(sides.size()) + 1;  // plus .notdef
+  std::vector<uint8_t> glyf, loca;
+  Put32(loca, 0);  // .notdef, empty
+  Put32(loca, 0);
+  for (int i = 1; i < n; ++i) {
+    const int s = sides[i - 1];
+    Put16(glyf, 1);  // contours
+    Put16(glyf, 0);
+    Put16(glyf, 0);
+    Put16(glyf, s);
+    Put16(glyf, s);
+    Put16(glyf, 3);  // last point
+    Put16(glyf, 0);  // no instructions
+    for (int k = 0; k < 4; ++k) glyf.push_back(1);  // on curve, 16-bit deltas
+    for (int dx : {0, 0, s, 0}) Put16(glyf, uint16_t(dx));
+    for (int dy : {0, s, 0, -s}) Put16(glyf, uint16_t(dy));
+    Put32(loca, uint32_t(glyf.size()));
+  }
+
+  std::vector<uint8_t> head(54, 0);
+  head[18] = 1000 >> 8, head[19] = 1000 & 0xFF;  // unitsPerEm
+  head[40] = uint8_t(bbox >> 8), head[41] = uint8_t(bbox);  // xMax
+  head[42] = uint8_t(bbox >> 8), head[43] = uint8_t(bbox);  // yMax
+  head[51] = 1;                                             // long loca
+  std::vector<uint8_t> maxp;
+  Put32(maxp, 0x5000);
+  Put16(maxp, uint16_t(n));
+  std::vector<uint8_t> hhea(36, 0);
+  hhea[4] = 1000 >> 8, hhea[5] = 1000 & 0xFF;  // ascender
+  hhea[35] = uint8_t(n);                        // numberOfHMetrics
+  std::vector<uint8_t> hmtx;
+  for (int i = 0; i < n; ++i) {
+    Put16(hmtx, 1000);
+    Put16(hmtx, 0);
+  }
+  std::vector<uint8_t> cmap;
+  Put16(cmap, 0);
+  Put16(cmap, 1);
+  Put16(cmap, 3);
+  Put16(cmap, 10);
+  Put32(cmap, 12);
+  Put16(cmap, 12);  // format
+  Put16(cmap, 0);
+  Put32(cmap, 28);  // length
+  Put32(cmap, 0);
+  Put32(cmap, 1);  // one group
+  Put32(cmap, 'A');
+  Put32(cmap, uint32_t('A' + n - 2));
+  Put32(cmap, 1);
+
+  const std::pair<const char*, std::vector<uint8_t>*> tables[] = {
+      {"cmap", &cmap}, {"glyf", &glyf}, {"head", &head}, {"hhea", &hhea},
+      {"hmtx", &hmtx}, {"loca", &loca}, {"maxp", &maxp},
+  };
+  const int count = int(std::size(tables));
+  std::vector<uint8_t> font;
+  Put32(font, 0x00010000);
+  Put16(font, uint16_t(count));
+  for (int k = 0; k < 3; ++k) Put16(font, 0);
+  uint32_t at = 12 + 16 * count;
+  for (auto& [tag, data] : tables) {
+    font.insert(font.end(), tag, tag + 4);
+    Put32(font, 0);
+    Put32(font, at);
+    Put32(font, uint32_t(data->size()));
+    at += uint32_t((data->size() + 3) & ~size_t(3));
+  }
+  for (auto& [tag, data] : tables) {
+    font.insert(font.end(), data->begin(), data->end());
+    font.resize((font.size() + 3) & ~size_t(3), 0);
+  }
+  return font;
+}
+
+sdf::SdfConfig Config() {
+  sdf::SdfConfig cfg;
+  cfg.glyph_px = 16;
+  cfg.supersample = 4;
+  cfg.border_px = 2;
+  cfg.radius_px = 2;
+  cfg.cache_path.clear();
+  return cfg;
+}
+
+const std::chrono::microseconds kForever = std::chrono::seconds(10);
+
+// Runs Update() and waits for the pool until nothing more can be handed to
+// it; returns the number of glyphs copied in.
+int Settle(sdf::DynamicGlyphAtlas& atlas) {
+  int published = 0;
+  for (;;) {
+    published += atlas.Update(kForever);
+    if (atlas.Building() == 0) return published;
+    atlas.Flush();
+  }
+}
+
+// Two cells: the least recently drawn glyph goes first, and a glyph drawn
+// this frame is never evicted.
+void TestEviction(const ttf::FontLoader& font, sdf::TaskPool& pool) {
+  const sdf::SdfConfig cfg = Config();
+  // Cells are 16 + 2 * 2 = 20 texels; the page holds two side by side.
+  sdf::DynamicGlyphAtlas atlas(font, cfg, 40, 20, 1, pool);
+  atlas.BeginFrame();
+  CHECK(atlas.Find('A') == nullptr);
+  CHECK(atlas.Find('B') == nullptr);
+  CHECK(Settle(atlas) == 2);
+  const sdf::AtlasGlyph* a = atlas.Find('A');
+  const sdf::AtlasGlyph* b = atlas.Find('B');
+  CHECK(a && b);
+  const uint16_t b_u = b ? b->u : 0;
+
+  atlas.BeginFrame();
+  CHECK(atlas.Find('A') != nullptr);
+  CHECK(atlas.Find('C') == nullptr);
+  CHECK(Settle(atlas) == 1);
+  // C took B's cell; A, drawn this frame, kept its own.
+  const sdf::AtlasGlyph* c = atlas.Find('C');
+  CHECK(c && c->u == b_u);
+  CHECK(atlas.Find('A') != nullptr);
+  // B comes back only once a cell is free of this frame's glyphs.
+  CHECK(atlas.Find('B') == nullptr);
+  CHECK(Settle(atlas) == 0);
+  CHECK(atlas.Queued() == 1);
+  atlas.BeginFrame();
+  CHECK(atlas.Find('C') != nullptr);
+  CHECK(Settle(atlas) == 1);  // evicts A
+  CHECK(atlas.Find('B') != nullptr);
+  CHECK(atlas.Find('A') == nullptr);
+}
+
+// A reused cell is rewritten whole: the dirty rect is the full cell, and
+// texels of the larger evicted glyph read as outside.
+void TestDirty(const ttf::FontLoader& font, sdf::TaskPool& pool) {
+  const sdf::SdfConfig cfg = Config();
+  sdf::DynamicGlyphAtlas atlas(font, cfg, 20, 20, 1, pool);
+  atlas.BeginFrame();
+  atlas.Find('A');  // 1000 units, fills the cell
+  CHECK(Settle(atlas) == 1);
+  CHECK(atlas.Dirty().size() == 1);
+  atlas.ClearDirty();
+
+  atlas.BeginFrame();
+  atlas.Find('D');  // 250 units
+  CHECK(Settle(atlas) == 1);
+  CHECK(atlas.Dirty().size() == 1);
+  if (atlas.Dirty().size() == 1) {
+    const sdf::DirtyRect& d = atlas.Dirty()[0];
+    CHECK(d.page == 0 && d.x == 0 && d.y == 0 && d.w == 20 && d.h == 20);
+  }
+  const sdf::AtlasGlyph* g = atlas.Find('D');
+  CHECK(g != nullptr);
+  if (!g) return;
+  // Texels beyond D's box, border included, are all outside.
+  const uint8_t outside = sdf::EncodeNorm(-1.0f);
+  const uint8_t* px = atlas.Pixels(0);
+  const int x1 = g->u + g->w + cfg.border_px, y0 = g->v - cfg.border_px;
+  bool clear = true;
+  for (int y = 0; y < 20; ++y)
+    for (int x = 0; x < 20; ++x)
+      if ((x >= x1 || y < y0) && px[y * 20 + x] != outside) clear = false;
+  CHECK(clear);
+}
+
+// Update() never builds a glyph itself: it hands queued glyphs to the pool
+// and copies in finished ones only while the budget lasts.
+void TestBudget(const ttf::FontLoader& font, sdf::TaskPool& pool) {
+  const sdf::SdfConfig cfg = Config();
+  sdf::DynamicGlyphAtlas atlas(font, cfg, 80, 20, 1, pool);
+  atlas.BeginFrame();
+  for (char32_t cp : {U'A', U'B', U'C', U'D'}) atlas.Find(cp);
+  CHECK(atlas.Update(std::chrono::microseconds(0)) == 0);
+  CHECK(atlas.Queued() == 0);
+  CHECK(atlas.Building() == 4);
+  atlas.Flush();
+  CHECK(atlas.Update(std::chrono::microseconds(0)) == 0);
+  CHECK(atlas.Find('A') == nullptr);
+  CHECK(atlas.Update(kForever) == 4);
+  CHECK(atlas.Building() == 0);
+  CHECK(atlas.Find('A') != nullptr);
+  CHECK(atlas.Dirty().size() == 4);
+}
+
+// A glyph beyond the font's bounding box is reported, not silently dropped.
+void TestTooLarge(const ttf::FontLoader& font, sdf::TaskPool& pool) {
+  const sdf::SdfConfig cfg = Config();
+  sdf::DynamicGlyphAtlas atlas(font, cfg, 20, 20, 1, pool);
+  atlas.BeginFrame();
+  CHECK(atlas.Find('E') == nullptr);  // 1500 units against a 1000 box
+  CHECK(atlas.Find('D') == nullptr);
+  CHECK(Settle(atlas) == 1);
+  const sdf::AtlasGlyph* e = atlas.Find('E');
+  CHECK(e && e->w == 0 && (e->flags & sdf::kAtlasGlyphTooLarge));
+  CHECK(e && e->advance == 16);
+  const sdf::AtlasGlyph* d = atlas.Find('D');
+  CHECK(d && d->w > 0 && d->flags == 0);
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<uint8_t> blob =
+      SquareFont({1000, 1000, 1000, 250, 1500}, 1000);
+  const ttf::FontLoader font(
+      std::span<const uint8_t>(blob.data(), blob.size()));
+  sdf::TaskPool pool(2);
+  TestEviction(font, pool);
+  TestDirty(font, pool);
+  TestBudget(font, pool);
+  TestTooLarge(font, pool);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("DynamicGlyphAtlas: all checks passed");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,417 @@
+// Checks PngEncoder and DeflateEncoder by decoding their output with an
+// inflate and a PNG reader written here from RFC 1950/1951 and the PNG
+// spec, independent of the encoder, and comparing against the input. Cases
+// cover gray, RGB and RGBA, width 1 and odd widths, more than two windows
+// of input so the encoder slides, and incompressible bytes, which use every
+// literal, span several Huffman blocks and need the 7-bit limit on the code
+// length code.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\PngWriterTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/PngWriterTest.cpp
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PngWriter.h"
+
+namespace {
+
+int failures = 0;
+
+void Fail(const std::string& name, const char* what) {
+  std::fprintf(stderr, "%s: %s\n", name.c_str(), what);
+  ++failures;
+}
+
+// What the inflater saw, to tell that a case reached the path it targets.
+struct InflateStats {
+  int blocks = 0;
+  int max_clen_bits = 0;  // longest code length code in any block
+};
+
+// Bit-at-a-time inflate after the reference decoder in zlib's contrib/puff.
+class Inflater {
+ public:
+  Inflater(const uint8_t* p, size_t n) : p_(p), n_(n) {}
+
+  // The zlib stream from its header to the Adler-32 trailer.
+  bool Zlib(std::vector<uint8_t>& out, InflateStats& stats) {
+    if (n_ < 6) return false;
+    const int cmf = p_[0], flg = p_[1];
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 ||
+        (flg & 0x20))
+      return false;
+    pos_ = 2;
+    for (bool last = false; !last;) {
+      last = Bits(1);
+      const int type = Bits(2);
+      ++stats.blocks;
+      bool ok = false;
+      if (type == 0) ok = Stored(out);
+      if (type == 1) ok = Fixed(out);
+      if (type == 2) ok = Dynamic(out, stats);
+      if (!ok || bad_) return false;
+    }
+    bit_count_ = 0;  // the trailer starts on a byte boundary
+    if (pos_ + 4 > n_) return false;
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : out) {
+      a = (a + v) % 65521;
+      b = (b + a) % 65521;
+    }
+    const uint32_t want = uint32_t(p_[pos_]) << 24 | p_[pos_ + 1] << 16 |
+                          p_[pos_ + 2] << 8 | p_[pos_ + 3];
+    return want == (b << 16 | a) && pos_ + 4 == n_;
+  }
+
+ private:
+  struct Huffman {
+    int count[16] = {};
+    std::vector<int> symbol;
+  };
+
+  const uint8_t* p_;
+  size_t n_, pos_ = 0;
+  uint32_t bit_buf_ = 0;
+  int bit_count_ = 0;
+  bool bad_ = false;
+
+  int Bits(int need) {
+    uint32_t v = bit_buf_;
+    while (bit_count_ < need) {
+      if (pos_ >= n_) {
+        bad_ = true;
+        return 0;
+      }
+      v |= uint32_t(p_[pos_++]) << bit_count_;
+      bit_count_ += 8;
+    }
+    bit_buf_ = v >> need;
+    bit_count_ -= need;
+    return int(v & ((1u << need) - 1));
+  }
+
+  // False for an over-subscribed set of lengths; incomplete sets are legal
+  // only for a single code, which this decoder does not need to reject.
+  static bool Build(const uint8_t* len, int n, Huffman& h) {
+    std::fill(h.count, h.count + 16, 0);
+    for (int s = 0; s < n; ++s) ++h.count[len[s]];
+    int left = 1;
+    for (int b = 1; b < 16; ++b) {
+      left = left * 2 - h.count[b];
+      if (left < 0) return false;
+    }
+    int offs[16] = {};
+    for (int b = 1; b < 15; ++b) offs[b + 1] = offs[b] + h.count[b];
+    h.symbol.assign(n, 0);
+    for (int s = 0; s < n; ++s)
+      if (len[s]) h.symbol[offs[len[s]]++] = s;
+    return true;
+  }
+
+  int Decode(const Huffman& h) {
+    int code = 0, first = 0, index = 0;
+    for (int b = 1; b < 16; ++b) {
+      code |= Bits(1);
+      const int count = h.count[b];
+      if (code - count < first) return h.symbol[index + (code - first)];
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+      if (bad_) return -1;
+    }
+    return -1;
+  }
+
+  bool Stored(std::vector<uint8_t>& out) {
+    bit_buf_ = 0;
+    bit_count_ = 0;
+    if (pos_ + 4 > n_) return false;
+    const int len = p_[pos_] | p_[pos_ + 1] << 8;
+    const int nlen = p_[pos_ + 2] | p_[pos_ + 3] << 8;
+    pos_ += 4;
+    if (len != (~nlen & 0xFFFF) || pos_ + len > n_) return false;
+    out.insert(out.end(), p_ + pos_, p_ + pos_ + len);
+    pos_ += len;
+    return true;
+  }
+
+  bool Codes(std::vector<uint8_t>& out, const Huffman& lit,
+             const Huffman& dist) {
+    static const int kLenBase[29] = {3,  4,  5,  6,   7,   8,   9,   10,
+                                     11, 13, 15, 17,  19,  23,  27,  31,
+                                     35, 43, 51, 59,  67,  83,  99,  115,
+                                     131, 163, 195, 227, 258};
+    static const int kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                      1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const int kDistBase[30] = {
+        1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+        33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const int kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                       4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                       9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    for (;;) {
+      int sym = Decode(lit);
+      if (sym < 0) return false;
+      if (sym < 256) {
+        out.push_back(uint8_t(sym));
+        continue;
+      }
+      if (sym == 256) return true;
+      sym -= 257;
+      if (sym >= 29) return false;
+      const int len = kLenBase[sym] + Bits(kLenExtra[sym]);
+      const int dsym = Decode(dist);
+      if (dsym < 0 || dsym >= 30) return false;
+      const size_t d = size_t(kDistBase[dsym] + Bits(kDistExtra[dsym]));
+      if (d > out.size() || d > 32768) return false;
+      for (int k = 0; k < len; ++k) out.push_back(out[out.size() - d]);
+    }
+  }
+
+  bool Fixed(std::vector<uint8_t>& out) {
+    uint8_t len[288];
+    int s = 0;
+    for (; s < 144; ++s) len[s] = 8;
+    for (; s < 256; ++s) len[s] = 9;
+    for (; s < 280; ++s) len[s] = 7;
+    for (; s < 288; ++s) len[s] = 8;
+    Huffman lit, dist;
+    Build(len, 288, lit);
+    std::fill(len, len + 30, uint8_t(5));
+    Build(len, 30, dist);
+    return Codes(out, lit, dist);
+  }
+
+  bool Dynamic(std::vector<uint8_t>& out, InflateStats& stats) {
+    static const int kOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                   11, 4,  12, 3, 13, 2, 14, 1, 15};
+    const int nlen = Bits(5) + 257, ndist = Bits(5) + 1, ncode = Bits(4) + 4;
+    if (nlen > 286 || ndist > 30) return false;
+    uint8_t len[320] = {};
+    for (int i = 0; i < ncode; ++i) {
+      len[kOrder[i]] = uint8_t(Bits(3));
+      stats.max_clen_bits = std::max(stats.max_clen_bits, int(len[kOrder[i]]));
+    }
+    Huffman lencode;
+    if (!Build(len, 19, lencode)) return false;
+    std::fill(len, len + 320, uint8_t(0));
+    for (int i = 0; i < nlen + ndist;) {
+      const int sym = Decode(lencode);
+      if (sym < 0) return false;
+      if (sym < 16) {
+        len[i++] = uint8_t(sym);
+        continue;
+      }
+      int fill = 0, rep;
+      if (sym == 16) {
+        if (i == 0) return false;
+        fill = len[i - 1];
+        rep = 3 + Bits(2);
+      } else if (sym == 17) {
+        rep = 3 + Bits(3);
+      } else {
+        rep = 11 + Bits(7);
+      }
+      if (i + rep > nlen + ndist) return false;
+      while (rep--) len[i++] = uint8_t(fill);
+    }
+    if (len[256] == 0) return false;  // no end-of-block code
+    Huffman lit, dist;
+    if (!Build(len, nlen, lit) || !Build(len + nlen, ndist, dist))
+      return false;
+    return Codes(out, lit, dist);
+  }
+};
+
+uint32_t Crc(const uint8_t* p, size_t n) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < n; ++i) {
+    c ^= p[i];
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+  }
+  return ~c;
+}
+
+uint32_t Read32(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Decodes an 8-bit gray, RGB or RGBA PNG without interlacing into packed
+// rows. Every chunk CRC is checked, and all five filter types are undone.
+bool ReadPng(const std::vector<uint8_t>& png, int& w, int& h, int& channels,
+             std::vector<uint8_t>& pixels, InflateStats& stats) {
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G',
+                                        '\r', '\n', 0x1A, '\n'};
+  if (png.size() < 8 || std::memcmp(png.data(), kSignature, 8)) return false;
+  std::vector<uint8_t> idat;
+  bool header = false, end = false;
+  for (size_t at = 8; !end;) {
+    if (at + 12 > png.size()) return false;
+    const uint32_t n = Read32(&png[at]);
+    if (at + 12 + n > png.size()) return false;
+    const uint8_t* type = &png[at + 4];
+    const uint8_t* data = type + 4;
+    if (Crc(type, 4 + n) != Read32(data + n)) return false;
+    if (!std::memcmp(type, "IHDR", 4)) {
+      if (n != 13 || header) return false;
+      w = int(Read32(data));
+      h = int(Read32(data + 4));
+      channels = data[9] == 0 ? 1 : data[9] == 2 ? 3 : data[9] == 6 ? 4 : 0;
+      if (data[8] != 8 || !channels || data[10] || data[11] || data[12])
+        return false;
+      header = true;
+    } else if (!std::memcmp(type, "IDAT", 4)) {
+      idat.insert(idat.end(), data, data + n);
+    } else if (!std::memcmp(type, "IEND", 4)) {
+      end = true;
+      if (at + 12 + n != png.size()) return false;
+    }
+    at += 12 + n;
+  }
+  std::vector<uint8_t> raw;
+  Inflater inflater(idat.data(), idat.size());
+  if (!header || !inflater.Zlib(raw, stats)) return false;
+  const size_t pitch = size_t(w) * channels;
+  if (raw.size() != (pitch + 1) * h) return false;
+  pixels.assign(pitch * h, 0);
+  for (int y = 0; y < h; ++y) {
+    const uint8_t* in = &raw[y * (pitch + 1)];
+    uint8_t* row = &pixels[y * pitch];
+    const uint8_t* up = y ? row - pitch : nullptr;
+    for (size_t i = 0; i < pitch; ++i) {
+      const int a = i >= size_t(channels) ? row[i - channels] : 0;
+      const int b = up ? up[i] : 0;
+      const int c = up && i >= size_t(channels) ? up[i - channels] : 0;
+      int pred = 0;
+      switch (in[0]) {
+        case 0: break;
+        case 1: pred = a; break;
+        case 2: pred = b; break;
+        case 3: pred = (a + b) / 2; break;
+        case 4: {
+          const int p = a + b - c;
+          const int pa = std::abs(p - a), pb = std::abs(p - b),
+                    pc = std::abs(p - c);
+          pred = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+          break;
+        }
+        default: return false;
+      }
+      row[i] = uint8_t(in[1 + i] + pred);
+    }
+  }
+  return true;
+}
+
+enum class Fill { kSmooth, kRandom, kConstant };
+
+std::vector<uint8_t> Make(Fill fill, size_t n, int w, int channels,
+                          std::mt19937& rng) {
+  std::vector<uint8_t> v(n);
+  const size_t pitch = size_t(w) * channels;
+  for (size_t i = 0; i < n; ++i) {
+    switch (fill) {
+      case Fill::kSmooth: {  // overlapping distance ramps
+        const double x = double(i % pitch / channels), y = double(i / pitch);
+        const double d = std::sin(x * 0.11 + (i % channels)) * 40 +
+                         std::cos(y * 0.07) * 60 + (x - y) * 0.3;
+        v[i] = uint8_t(std::clamp(128.0 + d, 0.0, 255.0));
+        break;
+      }
+      case Fill::kRandom:
+        v[i] = uint8_t(rng());
+        break;
+      case Fill::kConstant:
+        v[i] = 0xFF;  // the largest Adler-32 sums
+        break;
+    }
+  }
+  return v;
+}
+
+// Encodes in uneven batches of rows and reads the image back.
+void RoundTrip(const char* label, int w, int h, int channels, Fill fill,
+               std::mt19937& rng, int min_blocks = 1) {
+  const std::string name = std::string(label) + " " + std::to_string(w) +
+                           "x" + std::to_string(h) + "x" +
+                           std::to_string(channels);
+  const size_t pitch = size_t(w) * channels;
+  const std::vector<uint8_t> image = Make(fill, pitch * h, w, channels, rng);
+  sdf::PngEncoder enc(w, h, channels);
+  std::vector<uint8_t> png;
+  enc.Begin(png);
+  for (int y = 0; y < h;) {
+    const int n = std::min(h - y, 1 + int(rng() % 37));
+    enc.AddRows(&image[y * pitch], n, png);
+    y += n;
+  }
+  enc.End(png);
+  int rw = 0, rh = 0, rc = 0;
+  std::vector<uint8_t> back;
+  InflateStats stats;
+  if (!ReadPng(png, rw, rh, rc, back, stats)) return Fail(name, "unreadable");
+  if (rw != w || rh != h || rc != channels) return Fail(name, "wrong header");
+  if (back != image) return Fail(name, "pixels differ");
+  if (stats.blocks < min_blocks) Fail(name, "fewer blocks than expected");
+}
+
+// The zlib stream alone, fed in uneven pieces.
+void RawRoundTrip(const char* name, Fill fill, size_t n, std::mt19937& rng,
+                  int min_blocks, bool limited = false) {
+  const std::vector<uint8_t> input = Make(fill, n, 64, 1, rng);
+  sdf::DeflateEncoder enc;
+  std::vector<uint8_t> z;
+  for (size_t at = 0; at < n;) {
+    const size_t take = std::min(n - at, size_t(1 + rng() % 20000));
+    enc.Add(&input[at], take, z);
+    at += take;
+  }
+  enc.Finish(z);
+  std::vector<uint8_t> back;
+  InflateStats stats;
+  Inflater inflater(z.data(), z.size());
+  if (!inflater.Zlib(back, stats)) return Fail(name, "undecodable stream");
+  if (back != input) return Fail(name, "bytes differ");
+  if (stats.blocks < min_blocks) Fail(name, "fewer blocks than expected");
+  if (limited && stats.max_clen_bits != 7)
+    Fail(name, "code length code not at its 7-bit limit");
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 rng(2024);
+  RoundTrip("smooth", 1, 1, 1, Fill::kSmooth, rng);
+  RoundTrip("smooth", 1, 300, 1, Fill::kSmooth, rng);
+  RoundTrip("random", 1, 77, 3, Fill::kRandom, rng);
+  RoundTrip("smooth", 7, 5, 3, Fill::kSmooth, rng);
+  RoundTrip("random", 13, 11, 4, Fill::kRandom, rng);
+  // Past 2 x 32 KiB of filtered rows, so the window slides.
+  RoundTrip("smooth", 333, 211, 1, Fill::kSmooth, rng);
+  RoundTrip("smooth", 301, 97, 3, Fill::kSmooth, rng);
+  RoundTrip("constant", 517, 301, 1, Fill::kConstant, rng);
+  // Incompressible, so every literal is used, over several blocks.
+  RoundTrip("random", 257, 129, 4, Fill::kRandom, rng, 3);
+  RoundTrip("random", 401, 203, 1, Fill::kRandom, rng, 2);
+
+  RawRoundTrip("empty", Fill::kRandom, 0, rng, 1);
+  RawRoundTrip("constant", Fill::kConstant, 300000, rng, 1);
+  // Plain Huffman codes for these code lengths run past 7 bits.
+  RawRoundTrip("random", Fill::kRandom, 200000, rng, 6, true);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("PngWriter: all checks passed");
+  return EXIT_SUCCESS;
+}
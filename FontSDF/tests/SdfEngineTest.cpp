@@ -0,0 +1,86 @@
+// Checks that the bit-plane search engines give the same bytes as
+// SdfBruteForce, the reference, on random planes: scattered discs, which
+// leave uniform texels around the outline, and pixel noise, which leaves
+// none.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\SdfEngineTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/SdfEngineTest.cpp
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "SdfGenerator.h"
+
+namespace {
+
+int failures = 0;
+
+void Discs(sdf::BitPlane& hi, std::mt19937& rng) {
+  std::uniform_int_distribution<int> px(0, hi.w - 1), py(0, hi.h - 1);
+  std::uniform_int_distribution<int> pr(1, std::max(2, hi.w / 6));
+  for (int k = 0; k < 6; ++k) {
+    const int cx = px(rng), cy = py(rng), r = pr(rng);
+    for (int y = std::max(0, cy - r); y <= std::min(hi.h - 1, cy + r); ++y)
+      for (int x = std::max(0, cx - r); x <= std::min(hi.w - 1, cx + r); ++x)
+        if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) hi.Set(x, y);
+  }
+}
+
+void Noise(sdf::BitPlane& hi, std::mt19937& rng) {
+  std::bernoulli_distribution set(0.02);
+  for (int y = 0; y < hi.h; ++y)
+    for (int x = 0; x < hi.w; ++x)
+      if (set(rng)) hi.Set(x, y);
+}
+
+template <class P>
+void Compare(const P& p, const char* name, sdf::TaskPool& pool,
+             std::mt19937& rng) {
+  sdf::GlyphScratch gs;
+  const int lo_w = 13, lo_h = 9;
+  for (int round = 0; round < 8; ++round) {
+    sdf::BitPlane hi(lo_w * p.ss, lo_h * p.ss);
+    if (round % 4 == 3)
+      Noise(hi, rng);
+    else
+      Discs(hi, rng);
+    std::vector<uint8_t> ref(lo_w * lo_h), out(lo_w * lo_h);
+    sdf::SdfBruteForce(p, pool, gs, hi, lo_w, lo_h, ref);
+    auto same = [&](const char* engine) {
+      if (out == ref) return;
+      std::fprintf(stderr, "%s, round %d: %s differs from brute\n", name,
+                   round, engine);
+      ++failures;
+    };
+    sdf::SdfSpiral(p, pool, gs, hi, lo_w, lo_h, out);
+    same("spiral");
+    sdf::SdfTiled(p, pool, gs, hi, lo_w, lo_h, out);
+    same("tiled");
+    sdf::SdfPyramid(p, pool, gs, hi, lo_w, lo_h, out);
+    same("pyramid");
+    sdf::SdfExactEdt(p, pool, gs, hi, lo_w, lo_h, out);
+    same("edt");
+  }
+}
+
+}  // namespace
+
+int main() {
+  sdf::TaskPool pool(4);
+  std::mt19937 rng(12345);
+  // The default parameters use the compile-time spiral table.
+  Compare(sdf::FixedParams<64, 5>{}, "64x, R 5", pool, rng);
+  Compare(sdf::RuntimeParams{8, 8 * 3}, "8x, R 3", pool, rng);
+  // Texel cells that straddle plane words.
+  Compare(sdf::RuntimeParams{12, 12 * 4}, "12x, R 4", pool, rng);
+  Compare(sdf::RuntimeParams{96, 96 * 2}, "96x, R 2", pool, rng);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("SdfEngine: all checks passed");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+// Checks that the levels BuildSdfMips derives from an atlas page match a
+// field generated directly at their resolution: the same random discs run
+// through SdfExactEdt at 2x and 4x the supersample factor into a half and a
+// quarter as many texels, with the same spread in their own texels. Discs
+// stay clear of the plane's edges, as glyphs stay inside their borders.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\SdfMipsTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/SdfMipsTest.cpp
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "SdfMips.h"
+
+namespace {
+
+int failures = 0;
+
+// Levels may differ from the direct field by this many of their texels:
+// level 0 quantizes distances to radius / 127 texels and is interpolated
+// between its texel centres, where the direct field measures each centre.
+constexpr float kTolerance = 0.3f;
+
+void Discs(sdf::BitPlane& hi, std::mt19937& rng) {
+  std::uniform_int_distribution<int> pr(hi.h / 16, hi.h / 4);
+  for (int k = 0; k < 4; ++k) {
+    const int r = pr(rng), m = r + hi.h / 48;
+    const int cx = std::uniform_int_distribution<int>(m, hi.w - 1 - m)(rng);
+    const int cy = std::uniform_int_distribution<int>(m, hi.h - 1 - m)(rng);
+    for (int y = std::max(0, cy - r); y <= std::min(hi.h - 1, cy + r); ++y)
+      for (int x = std::max(0, cx - r); x <= std::min(hi.w - 1, cx + r); ++x)
+        if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) hi.Set(x, y);
+  }
+}
+
+void Compare(int radius, sdf::TaskPool& pool, std::mt19937& rng) {
+  sdf::GlyphScratch gs;
+  const int ss = 8, lo_w = 64, lo_h = 48, levels = 3;
+  for (int round = 0; round < 6; ++round) {
+    sdf::BitPlane hi(lo_w * ss, lo_h * ss);
+    Discs(hi, rng);
+    std::vector<uint8_t> page(lo_w * lo_h);
+    sdf::SdfExactEdt(sdf::RuntimeParams{ss, ss * radius}, pool, gs, hi, lo_w,
+                     lo_h, page);
+    const std::vector<sdf::MipLevel> chain =
+        sdf::BuildSdfMips(page.data(), lo_w, lo_h, 1, radius, levels);
+    for (int k = 1; k < levels; ++k) {
+      const int s = ss << k, w = lo_w >> k, h = lo_h >> k;
+      std::vector<uint8_t> direct(w * h);
+      sdf::SdfExactEdt(sdf::RuntimeParams{s, s * radius}, pool, gs, hi, w, h,
+                       direct);
+      const sdf::MipLevel& m = chain[k - 1];
+      if (m.w != w || m.h != h) {
+        std::fprintf(stderr, "R %d, level %d: %d x %d, expected %d x %d\n",
+                     radius, k, m.w, m.h, w, h);
+        ++failures;
+        continue;
+      }
+      int worst = 0;
+      for (int i = 0; i < w * h; ++i)
+        worst = std::max(worst, std::abs(m.texels[i] - direct[i]));
+      const float off = worst * radius / 127.0f;
+      if (off > kTolerance) {
+        std::fprintf(stderr, "R %d, round %d, level %d: off by %.2f texels\n",
+                     radius, round, k, off);
+        ++failures;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  sdf::TaskPool pool(4);
+  std::mt19937 rng(2024);
+  Compare(5, pool, rng);
+  Compare(3, pool, rng);
+  Compare(8, pool, rng);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("SdfMips: all checks passed");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+// Checks that every distance kernel the CPU supports gives the same results
+// as the scalar reference on random planes and arrays, and that the scalar
+// row search agrees with BitPlane::NearestInRow. The BC4 block encoders are
+// held to the same bytes as the scalar one, and its blocks must decode to
+// within half a palette step of the input.
+//
+// Build and run from FontSDF/, e.g.
+//   cl /std:c++20 /EHsc /O2 /I. tests\SimdKernelsTest.cpp
+//   g++ -std=c++20 -O2 -pthread -I. tests/SimdKernelsTest.cpp
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Bc4Encoder.h"
+#include "BitPlane.h"
+#include "SimdKernels.h"
+
+namespace {
+
+int failures = 0;
+
+void Fail(const sdf::DistanceKernels& k, const char* what, int round) {
+  std::fprintf(stderr, "%s: %s differs from scalar, round %d\n", k.name,
+               what, round);
+  ++failures;
+}
+
+// Widths around word boundaries, with sparse, dense and near-full planes.
+void TestRowNearest(const std::vector<sdf::DistanceKernels>& all,
+                    std::mt19937& rng) {
+  static const int kWidths[] = {1, 5, 63, 64, 65, 127, 128, 200, 320};
+  static const double kDensity[] = {0.0, 0.002, 0.05, 0.5, 0.98, 1.0};
+  const sdf::DistanceKernels& ref = all.back();
+  for (int round = 0; round < 4000; ++round) {
+    const int w = kWidths[round % std::size(kWidths)];
+    sdf::BitPlane bp(w, 16);
+    std::bernoulli_distribution set(kDensity[rng() % std::size(kDensity)]);
+    for (int y = 0; y < bp.h; ++y)
+      for (int x = 0; x < w; ++x)
+        if (set(rng)) bp.Set(x, y);
+    const uint64_t* rows[16];
+    const int n = int(rng() % 17);
+    for (int i = 0; i < n; ++i) rows[i] = bp.Row(int(rng() % bp.h));
+    const int cx = int(rng() % w);
+    const int limit = 1 + int(rng() % 400);
+    const bool value = rng() & 1;
+    int32_t want[16], got[16];
+    ref.row_nearest(rows, n, bp.pitch, w, cx, value, limit, want);
+    for (int i = 0; i < n; ++i) {
+      const int y = int((rows[i] - bp.data.data()) / bp.pitch);
+      const int dx = bp.NearestInRow(y, cx, value);
+      if (want[i] != (dx >= 0 && dx <= limit ? dx : limit + 1)) {
+        std::fprintf(stderr, "scalar row search differs from NearestInRow, "
+                             "round %d\n", round);
+        ++failures;
+        break;
+      }
+    }
+    for (const sdf::DistanceKernels& k : all) {
+      std::fill(got, got + 16, -7);
+      k.row_nearest(rows, n, bp.pitch, w, cx, value, limit, got);
+      if (!std::equal(want, want + n, got)) Fail(k, "row_nearest", round);
+    }
+  }
+}
+
+void TestMinDistSq(const std::vector<sdf::DistanceKernels>& all,
+                   std::mt19937& rng) {
+  const sdf::DistanceKernels& ref = all.back();
+  std::uniform_int_distribution<int> coord(0, 400);
+  for (int round = 0; round < 4000; ++round) {
+    const int n = int(rng() % 17);
+    int32_t dx[16], dy2[16];
+    for (int i = 0; i < n; ++i) {
+      dx[i] = coord(rng);
+      dy2[i] = coord(rng) * coord(rng);
+    }
+    const int best = 1 + int(rng() % 200000);
+    const int want = ref.min_dist_sq(dx, dy2, n, best);
+    for (const sdf::DistanceKernels& k : all)
+      if (k.min_dist_sq(dx, dy2, n, best) != want)
+        Fail(k, "min_dist_sq", round);
+  }
+}
+
+// Two rows swept in turn, so the runs carry over from the first.
+void TestSweepRow(const std::vector<sdf::DistanceKernels>& all,
+                  std::mt19937& rng) {
+  const sdf::DistanceKernels& ref = all.back();
+  for (int round = 0; round < 1000; ++round) {
+    const int w = 1 + int(rng() % 300);
+    sdf::BitPlane bp(w, 2);
+    std::bernoulli_distribution set(0.05 + 0.9 * (rng() % 2));
+    for (int y = 0; y < 2; ++y)
+      for (int x = 0; x < w; ++x)
+        if (set(rng)) bp.Set(x, y);
+    std::vector<int32_t> want_clear(w), want_set(w);
+    for (int y = 0; y < 2; ++y)
+      ref.sweep_row(bp.Row(y), w, want_clear.data(), want_set.data());
+    for (const sdf::DistanceKernels& k : all) {
+      std::vector<int32_t> clear(w), set_run(w);
+      for (int y = 0; y < 2; ++y)
+        k.sweep_row(bp.Row(y), w, clear.data(), set_run.data());
+      if (clear != want_clear || set_run != want_set)
+        Fail(k, "sweep_row", round);
+    }
+  }
+}
+
+// Texel i of a BC4 block in the eight-value mode, before any rounding.
+float DecodeBc4(const uint8_t* block, int i) {
+  uint64_t bits = 0;
+  for (int k = 5; k >= 0; --k) bits = (bits << 8) | block[2 + k];
+  const int idx = int(bits >> (3 * i)) & 7;
+  const float p0 = block[0], p1 = block[1];
+  if (idx < 2) return idx ? p1 : p0;
+  return ((8 - idx) * p0 + (idx - 1) * p1) / 7.0f;
+}
+
+// Random, constant and two-level blocks, with ranges 0, 1 and 255 among
+// them, each read at every pitch from the middle of a wider image.
+void TestBc4(const std::vector<sdf::Bc4Kernel>& all, std::mt19937& rng) {
+  static const size_t kPitches[] = {4, 8, 12, 64, 1024, 4096};
+  const sdf::Bc4Kernel& ref = all.back();
+  for (int round = 0; round < 20000; ++round) {
+    uint8_t v[16];
+    const int lo = int(rng() % 256);
+    switch (round % 6) {
+      case 0:  // range 0
+        std::fill(v, v + 16, uint8_t(lo));
+        break;
+      case 1:  // range 1
+        for (uint8_t& x : v) x = uint8_t(std::min(255, lo + int(rng() % 2)));
+        v[rng() % 16] = uint8_t(std::min(lo, 254));
+        v[rng() % 16] = uint8_t(std::min(lo, 254) + 1);
+        break;
+      case 2:  // range 255
+        for (uint8_t& x : v) x = uint8_t(rng());
+        v[rng() % 16] = 0;
+        v[rng() % 16] = 255;
+        break;
+      case 3: {  // a distance ramp
+        const int dx = int(rng() % 41) - 20, dy = int(rng() % 41) - 20;
+        for (int i = 0; i < 16; ++i)
+          v[i] = uint8_t(std::clamp(lo + dx * (i % 4) + dy * (i / 4), 0, 255));
+        break;
+      }
+      default: {  // random within a random range
+        const int span = 1 + int(rng() % (256 - lo));
+        for (uint8_t& x : v) x = uint8_t(lo + int(rng() % span));
+      }
+    }
+    const size_t pitch = kPitches[(round / 6) % std::size(kPitches)];
+    std::vector<uint8_t> image(pitch * 4 + 8, 0xA5);
+    uint8_t* src = image.data() + 4;
+    for (int y = 0; y < 4; ++y)
+      std::copy(v + y * 4, v + y * 4 + 4, src + y * pitch);
+    uint8_t want[8], got[8];
+    ref.block(src, pitch, want);
+    const uint8_t hi = *std::max_element(v, v + 16);
+    const uint8_t lo_v = *std::min_element(v, v + 16);
+    const float half_step = (hi - lo_v) / 14.0f + 1e-3f;
+    for (int i = 0; i < 16; ++i)
+      if (std::abs(DecodeBc4(want, i) - v[i]) > half_step) {
+        std::fprintf(stderr, "scalar BC4 texel %d off by more than half a "
+                             "step, round %d\n", i, round);
+        ++failures;
+        break;
+      }
+    for (const sdf::Bc4Kernel& k : all) {
+      std::fill(got, got + 8, 0);
+      k.block(src, pitch, got);
+      if (!std::equal(want, want + 8, got)) {
+        std::fprintf(stderr, "%s: BC4 block differs from scalar, round %d\n",
+                     k.name, round);
+        ++failures;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<sdf::DistanceKernels> all = sdf::SupportedKernels();
+  for (const sdf::DistanceKernels& k : all)
+    std::printf("kernel: %s\n", k.name);
+  std::mt19937 rng(2024);
+  TestRowNearest(all, rng);
+  TestMinDistSq(all, rng);
+  TestSweepRow(all, rng);
+  const std::vector<sdf::Bc4Kernel> bc4 = sdf::SupportedBc4Kernels();
+  for (const sdf::Bc4Kernel& k : bc4) std::printf("BC4 kernel: %s\n", k.name);
+  TestBc4(bc4, rng);
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  std::puts("SimdKernels: all checks passed");
+  return EXIT_SUCCESS;
+}